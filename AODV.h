@@ -15,9 +15,20 @@
 
 /*-------------------VALUES-------------*/
 #define INF 50                 // Infinite
+#define MAX_REQ_ID 0xFFFF      // request id is 16 bit wide (per source)
+#define MAX_EPOCH 0xFF         // boot epoch is 8 bit wide (0: none)
+
+/*-------------------FEATURES-----------*/    // they shape the DATA packet (settable from make DEFINES)
+#ifndef RELIABLE_DATA
+#define RELIABLE_DATA 0        // 1: my DATA toward a node is numbered, acknowledged and retransmitted
+#endif
+#ifndef GROUP_TRAFFIC
+#define GROUP_TRAFFIC 0        // 1: nodes join a group and groups are DATA destinations too (join floods, see README)
+#endif
 
 /*-------------------FIXED SIZES--------*/
 #define DATA_PAYLOAD_LEN 11     // length of payload in data packages
+#define REQ_WINDOW_SIZE 32      // number of recent request ids remembered per source
 
 
 /******************************************************************/
@@ -26,23 +37,40 @@
 /*--------------------PACKETS-----------------*/
 // data packet
 struct DATA_PACKET{
-    int dest;
+    int dest;               // node or group address
+    int src;                // originator
+    unsigned int epoch;     // boot epoch of src, which numbers seq
+    unsigned int ack_epoch; // reliable DATA: boot epoch of dest that ack and sack refer to
+    unsigned int seq;       // reliable DATA: sequence number in the flow (0: unreliable)
+    unsigned int ack;       // reliable DATA: next seq expected from dest (0: no ack)
+    unsigned int sack;      // reliable DATA: bit i set if seq ack+i was received too
+    unsigned int mask;      // group DATA: members still to reach (bit n-1 for node n)
+    int load;               // frames queued at the sender
     char payload[DATA_PAYLOAD_LEN];
 };
 
 // route request packet
 struct RREQ_PACKET{
-    int req_id;
+    unsigned int req_id;
     int dest;
     int src;
+    int ttl;        // remaining hops the request may be forwarded
+    unsigned int epoch;     // boot epoch of src, which numbers req_id
 };
 
 // route reply packet
 struct RREP_PACKET{
-    int req_id;
+    unsigned int req_id;
     int dest;
     int src;
     int hops;
+    int load;       // highest queue load along the path
+    unsigned int epoch;     // boot epoch of the node that numbered req_id (beacon: the sink)
+};
+
+// route error packet (destination no longer reachable through sender)
+struct RERR_PACKET{
+    int dest;
 };
 
 /*--------------------TABLES-----------------*/
@@ -51,20 +79,44 @@ struct ROUTING_TABLE_ENTRY{
     int dest;
     int next;
     int hops;       // number of hops to destination
+    int load;       // highest queue load along the route when learned
     int age;        // age of current entry
+    int alive;      // time since the route was installed
+    int used;       // bool: DATA went through it since it was installed
+    int restored;   // bool: reloaded from flash, not confirmed yet
     int valid;      // bool: is the current entry valid?
 };
 
+// link table entry (history of a neighbor used as next hop)
+struct LINK_TABLE_ENTRY{
+    int lifetime;   // lifetime given to routes through this neighbor
+    int rssi;       // smoothed signal strength of its frames
+    int load;       // frames queued at the neighbor (last heard)
+    int cwnd;       // DATA frames per second it may receive from me
+    int credit;     // DATA frames still allowed in the current second
+    int valid;      // bool: was the neighbor ever heard?
+};
+
 // waiting table entry (waiting for route reply)
 struct DISCOVERY_TABLE_ENTRY{
-    int req_id;
+    unsigned int req_id;
     int src;
     int dest;
     int snd;
+    int ttl;
+    unsigned int epoch;     // boot epoch of src
     int valid;
     int age;
 };
 
+// duplicate request cache entry (one per source)
+struct REQ_CACHE_ENTRY{
+    unsigned int last_id;   // newest request id seen from the source
+    unsigned long window;   // bit i set: request (last_id - i) already seen
+    unsigned int epoch;     // boot epoch of the source that numbered last_id
+    int valid;
+};
+
 // queue entry data packages to be sent
 struct QUEUE_ENTRY{
     struct DATA_PACKET data_pkg;
@@ -72,4 +124,33 @@ struct QUEUE_ENTRY{
     int valid;
 };
 
+// reliable transport: DATA sent and not acknowledged yet
+struct SEND_WINDOW_ENTRY{
+    struct DATA_PACKET data_pkg;
+    unsigned long sent;     // clock time of the last transmission
+    int retries;
+    int valid;
+};
+
+// reliable transport: state of the flow toward / from a node
+struct FLOW_ENTRY{
+    unsigned int last_seq;  // sender: seq of the last new DATA (0: none yet)
+    int srtt;               // sender: smoothed round trip time (clock ticks)
+    int rttvar;             // sender: round trip time variation (clock ticks)
+    int rto;                // sender: retransmission timeout (clock ticks)
+    unsigned int epoch;     // receiver: boot epoch of the source (0: no DATA yet)
+    unsigned int expected;  // receiver: first seq not received yet
+    unsigned int received;  // receiver: bit i set if seq expected+i already received
+    int unacked;            // receiver: DATA received in order and not acknowledged yet
+    unsigned long ack_time; // receiver: clock time the pending acknowledgement is due
+};
+
+// profiling: statistics of a handler or table operation (rtimer ticks)
+struct PROFILE_ENTRY{
+    unsigned long total;
+    unsigned long calls;
+    unsigned int min;
+    unsigned int max;
+};
+
 #endif  // AODV_H
@@ -0,0 +1,306 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<simconf>
+  <project EXPORT="discard">[APPS_DIR]/mrm</project>
+  <project EXPORT="discard">[APPS_DIR]/mspsim</project>
+  <project EXPORT="discard">[APPS_DIR]/avrora</project>
+  <project EXPORT="discard">[APPS_DIR]/serial_socket</project>
+  <project EXPORT="discard">[APPS_DIR]/collect-view</project>
+  <project EXPORT="discard">[APPS_DIR]/powertracker</project>
+  <simulation>
+    <title>LOAD_single_channel</title>
+    <speedlimit>1.0</speedlimit>
+    <randomseed>123456</randomseed>
+    <motedelay_us>1000000</motedelay_us>
+    <radiomedium>
+      se.sics.cooja.radiomediums.UDGM
+      <transmitting_range>50.0</transmitting_range>
+      <interference_range>100.0</interference_range>
+      <success_ratio_tx>1.0</success_ratio_tx>
+      <success_ratio_rx>1.0</success_ratio_rx>
+    </radiomedium>
+    <events>
+      <logoutput>40000</logoutput>
+    </events>
+    <motetype>
+      se.sics.cooja.mspmote.SkyMoteType
+      <identifier>sky1</identifier>
+      <description>Sky Mote Type #sky1</description>
+      <source EXPORT="discard">[CONFIG_DIR]/main.c</source>
+      <commands EXPORT="discard">make clean TARGET=sky
+make main.sky TARGET=sky DEFINES=SINK_NODE=1,DATA_PACKAGE_DELTA_TIME=5</commands>
+      <firmware EXPORT="copy">[CONFIG_DIR]/main.sky</firmware>
+      <moteinterface>se.sics.cooja.interfaces.Position</moteinterface>
+      <moteinterface>se.sics.cooja.interfaces.RimeAddress</moteinterface>
+      <moteinterface>se.sics.cooja.interfaces.IPAddress</moteinterface>
+      <moteinterface>se.sics.cooja.interfaces.Mote2MoteRelations</moteinterface>
+      <moteinterface>se.sics.cooja.interfaces.MoteAttributes</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.MspClock</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.MspMoteID</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.SkyButton</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.SkyFlash</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.SkyCoffeeFilesystem</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.Msp802154Radio</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.MspSerial</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.SkyLED</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.MspDebugOutput</moteinterface>
+      <moteinterface>se.sics.cooja.mspmote.interfaces.SkyTemperature</moteinterface>
+    </motetype>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>36.647398843930645</x>
+        <y>21.38728323699421</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>1</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>12.485549132947979</x>
+        <y>51.58959537572254</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>2</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>70.34682080924857</x>
+        <y>24.884393063583808</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>3</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>107.22543352601159</x>
+        <y>43.641618497109825</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>4</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>99.91329479768788</x>
+        <y>76.06936416184972</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>5</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>79.2485549132948</x>
+        <y>53.49710982658959</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>6</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>62.08092485549134</x>
+        <y>79.2485549132948</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>7</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+    <mote>
+      <breakpoints />
+      <interface_config>
+        se.sics.cooja.interfaces.Position
+        <x>31.878612716762998</x>
+        <y>86.5606936416185</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        se.sics.cooja.mspmote.interfaces.MspMoteID
+        <id>8</id>
+      </interface_config>
+      <motetype_identifier>sky1</motetype_identifier>
+    </mote>
+  </simulation>
+  <plugin>
+    se.sics.cooja.plugins.SimControl
+    <width>280</width>
+    <z>0</z>
+    <height>142</height>
+    <location_x>353</location_x>
+    <location_y>-1</location_y>
+  </plugin>
+  <plugin>
+    se.sics.cooja.plugins.Visualizer
+    <plugin_config>
+      <moterelations>true</moterelations>
+      <skin>se.sics.cooja.plugins.skins.IDVisualizerSkin</skin>
+      <skin>se.sics.cooja.plugins.skins.UDGMVisualizerSkin</skin>
+      <skin>se.sics.cooja.plugins.skins.TrafficVisualizerSkin</skin>
+      <viewport>3.1454545454545446 0.0 0.0 3.1454545454545446 -18.272727272727227 23.72727272727278</viewport>
+    </plugin_config>
+    <width>340</width>
+    <z>2</z>
+    <height>400</height>
+    <location_x>1</location_x>
+    <location_y>1</location_y>
+  </plugin>
+  <plugin>
+    se.sics.cooja.plugins.LogListener
+    <plugin_config>
+      <filter />
+      <formatted_time />
+      <coloring />
+    </plugin_config>
+    <width>739</width>
+    <z>1</z>
+    <height>315</height>
+    <location_x>341</location_x>
+    <location_y>140</location_y>
+  </plugin>
+  <plugin>
+    se.sics.cooja.plugins.TimeLine
+    <plugin_config>
+      <mote>0</mote>
+      <mote>1</mote>
+      <mote>2</mote>
+      <mote>3</mote>
+      <mote>4</mote>
+      <mote>5</mote>
+      <mote>6</mote>
+      <mote>7</mote>
+      <showRadioRXTX />
+      <showRadioHW />
+      <showLEDs />
+      <zoomfactor>500.0</zoomfactor>
+    </plugin_config>
+    <width>1080</width>
+    <z>4</z>
+    <height>293</height>
+    <location_x>0</location_x>
+    <location_y>407</location_y>
+  </plugin>
+  <plugin>
+    se.sics.cooja.plugins.MoteInterfaceViewer
+    <mote_arg>2</mote_arg>
+    <plugin_config>
+      <interface>Sky LED</interface>
+      <scrollpos>0,0</scrollpos>
+    </plugin_config>
+    <width>448</width>
+    <z>3</z>
+    <height>145</height>
+    <location_x>631</location_x>
+    <location_y>-2</location_y>
+  </plugin>
+  <plugin>
+    se.sics.cooja.plugins.ScriptRunner
+    <plugin_config>
+      <script>/*
+ * Throughput meter: DATA delivered per minute, with the ROUTE_REQUEST
+ * floods competing for the air in the same minute. After RUN_MINUTES it
+ * prints the totals and ends the run, failed if no DATA was delivered.
+ * AODV_Load_SingleChannel.csc and AODV_Load_MultiChannel.csc build the
+ * same network with sink 1 and DATA every 5 secs per node, on one RF
+ * channel and with DATA on its own channel: compare their totals.
+ * With GROUP_TRAFFIC 1 it also compares group DATA frames per delivered
+ * group message with the frames repeated unicast would need.
+ */
+TIMEOUT(1900000, log.log("Run did not end: total DATA delivered " + total + "\n"));
+
+var RUN_MINUTES = 30;
+var period = 60000000; /* us */
+var next = period;
+var delivered = 0, sent = 0, rreq = 0, total = 0, totalSent = 0, totalRreq = 0;
+var gFrames = 0, gUnicast = 0, gDelivered = 0;
+
+function groupReport() {
+  if(gDelivered == 0)
+    return;
+  log.log("Group DATA: " + gDelivered + " deliveries, "
+          + (gFrames/gDelivered).toFixed(2) + " frames each (" + gFrames + "), repeated unicast "
+          + (gUnicast/gDelivered).toFixed(2) + " (" + gUnicast + ")\n");
+}
+
+while(true) {
+  YIELD();
+  if(msg.indexOf("DATA RECEIVED") &gt;= 0) {
+    delivered++;
+    if(msg.indexOf("GROUP") == 0)
+      gDelivered++;
+  }
+  else if(msg.indexOf("GROUP") == 0 &amp;&amp; msg.indexOf(" FRAME via ") &gt;= 0) {
+    gFrames++;
+    gUnicast += parseInt(msg.substring(msg.indexOf("unicast ") + 8));
+  }
+  else if(msg.indexOf("Sending DATA") &gt;= 0)
+    sent++;
+  else if(msg.indexOf("Broadcasting ROUTE_REQUEST") &gt;= 0)
+    rreq++;
+
+  while(time &gt;= next) {
+    total += delivered;
+    totalSent += sent;
+    totalRreq += rreq;
+    log.log("Minute " + next/period + ": DATA delivered " + delivered
+            + ", DATA frames " + sent + ", ROUTE_REQUEST " + rreq
+            + " (total delivered " + total + ")\n");
+    groupReport();
+    delivered = 0; sent = 0; rreq = 0;
+    if(next/period &gt;= RUN_MINUTES) {
+      log.log("Total in " + RUN_MINUTES + " minutes: DATA delivered " + total
+              + ", DATA frames " + totalSent + ", ROUTE_REQUEST " + totalRreq + "\n");
+      if(total &gt; 0)
+        log.testOK();
+      else
+        log.testFailed();
+    }
+    next += period;
+  }
+}</script>
+      <active>true</active>
+    </plugin_config>
+    <width>600</width>
+    <z>5</z>
+    <height>500</height>
+    <location_x>480</location_x>
+    <location_y>100</location_y>
+  </plugin>
+</simconf>
+
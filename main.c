@@ -10,8 +10,12 @@
 // contiki
 #include "contiki.h"
 #include "net/rime.h"
+#include "net/netstack.h"
 #include "dev/leds.h"
 #include "dev/button-sensor.h"
+#include "dev/cc2420.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
 
 // AODV
 #include "struct2packet.h"
@@ -21,21 +25,177 @@
 /*------------------------DEFINES-----------------------------------------*/
 
 /*-----------NODES---------------------------*/
-#define MAX_NODES 8     // total number of nodes 
+#define MAX_NODES 8     // total number of nodes (at most 16, one bit each in group DATA)
 #define MAX_DATA_IN_QUEUE 10    // Maximum data packages waiting to be sent
 #define DISCO_SIZE MAX_NODES*MAX_NODES//------------ DO NOT MODIFY!!
+#define IS_NODE(n) ((n) >= 1 && (n) <= MAX_NODES)  // node address (not a group)
+#define NODE_BIT(n) (1U << ((n)-1))    // bit of node n in a group mask
+
+/*-----------SINK----------------------------*/
+#ifndef SINK_NODE       // settable from make: DEFINES=SINK_NODE=1 (so are MULTI_CHANNEL and DATA_PACKAGE_DELTA_TIME)
+#define SINK_NODE 0     // collector announcing itself with periodic beacons (0 = no sink)
+#endif
+
+/*-----------GROUPS--------------------------*/    // switched on by GROUP_TRAFFIC (AODV.h)
+#define MAX_GROUPS 2    // group addresses follow node ones: MAX_NODES+1 ... MAX_NODES+MAX_GROUPS
+#define IS_GROUP(n) ((n) > MAX_NODES && (n) <= MAX_NODES+MAX_GROUPS)
+#define MY_GROUP (MAX_NODES + 1 + rimeaddr_node_addr.u8[0] % MAX_GROUPS)  // group joined by this node
+#define DATA_DESTS (GROUP_TRAFFIC ? MAX_NODES + MAX_GROUPS : MAX_NODES)   // addresses DATA is sent to
 
 /*-----------CHANNELS------------------------*/
 #define BROADCAST_CHANNEL 26
 #define RREP_CHANNEL 22
 #define DATA_CHANNEL 23
+#define RERR_CHANNEL 24
+#define BEACON_CHANNEL 25
 #define RREQ_CHANNEL BROADCAST_CHANNEL //------------ DO NOT MODIFY!!
 
+/*-----------RADIO FREQUENCIES---------------*/
+#ifndef MULTI_CHANNEL
+#define MULTI_CHANNEL 0         // 1: DATA on its own 802.15.4 channel (schedule follows SINK_NODE beacons)
+#endif
+#define CONTROL_RF_CHANNEL 26   // 802.15.4 channel of control traffic (and of everything when not scheduled)
+#define DATA_RF_CHANNEL 15      // 802.15.4 channel of DATA during the data slot
+#define RF_HOP_DELAY (MAC_CYCLE/2)              // mean beacon delay per hop (a ContikiMAC broadcast is heard anywhere in a cycle)
+#define RF_GUARD (MAC_MAX_TX_TIME + MAC_CYCLE)  // no new frame this close to the end of a slot: worst frame + skew left between neighbors
+#define RF_CONTROL_SLOT (2*RF_GUARD)            // first part of the cycle, on CONTROL_RF_CHANNEL
+#define RF_CYCLE (CLOCK_CONF_SECOND * SINK_BEACON_TIME / 2)  // control slot + data slot (two per beacon round)
+#define RF_SLOT_CHANNEL() ((rfSynced != 0 && rfDataSlot != 0) ? DATA_RF_CHANNEL : CONTROL_RF_CHANNEL)
+#define RF_SYNC_TIMEOUT (3*SINK_BEACON_TIME)    // schedule dropped if no beacon is heard for this long
+#define RF_PEER_UNSYNCED(n) (MULTI_CHANNEL && SINK_NODE != 0 && (rfSynced == 0 || rfPeerSync[(n)-1] == 0))  // n may be on the other channel
+#if MULTI_CHANNEL && SINK_NODE != 0
+#define RF_CONTROL_WAIT (2 * RF_CYCLE / CLOCK_CONF_SECOND)  // secs: request and reply may each wait a cycle for a control slot
+#else
+#define RF_CONTROL_WAIT 0
+#endif
+
 /*-----------TIME CONSTRAINTS----------------*/
-#define ROUTE_DISCOVERY_TIME 1   // maximum time to obtain route to a destination
-#define ROUTE_EXPIRATION_TIME 90   // maximum time a route entry is considered valid
+#define ROUTE_DISCOVERY_TIME (1 + RF_CONTROL_WAIT)   // maximum time to obtain route to a destination
+#define ROUTE_EXPIRATION_TIME 90   // initial lifetime of a route entry (adapted per next hop)
+#define MIN_ROUTE_LIFETIME 10   // lifetime bounds of routes through volatile / stable links
+#define MAX_ROUTE_LIFETIME 600
+#ifndef DATA_PACKAGE_DELTA_TIME
 #define DATA_PACKAGE_DELTA_TIME 30
-#define MAX_QUEUEING_TIME 5    // Maximum time for a data package to remain in the queue before being discarded
+#endif
+#define MAX_QUEUEING_TIME (5 + RF_CONTROL_WAIT)    // Maximum time for a data package to remain in the queue before being discarded
+#define DISCOVERY_COALESCE_TIME (2 + RF_CONTROL_WAIT)   // time a pending ROUTE_REQ covers new data toward the same destination
+#define CHECKPOINT_TIME 30      // minimum time between two writes of the routing state to flash
+#define ROUTE_REVALIDATION_TIME 10  // lifetime of a route restored from flash until it is confirmed
+#define LOCAL_REPAIR_TIME (2 + RF_CONTROL_WAIT)     // time given to a local repair before the route error is propagated
+#define GROUP_JOIN_TIME 60      // period of the group membership announcement
+#define SINK_BEACON_TIME 20     // period of the sink beacon (route refresh toward the sink)
+#define GROUP_MEMBERSHIP_TIME 150   // a member not heard for this long leaves the group
+
+/*-----------LINK QUALITY--------------------*/
+#define WEAK_LINK_RSSI -40      // CC2420 RSSI register value (dBm = value - 45) of an unreliable link
+
+/*-----------CONGESTION----------------------*/
+#define CONGESTION_LOAD 6       // frames queued at a node considered congested
+#define CONGESTION_HOP_COST 3   // queued frames along a route weighted as one extra hop
+#define MAX_CWND 4              // DATA frames per second a neighbor may receive from me
+#define MAX_DATA_DELTA_TIME 240 // slowest DATA generation period under congestion
+#define DATA_DELTA_STEP 5       // speed-up of DATA generation per period without congestion
+#define ROUTE_COST(hops, load) ((hops) + (load)/CONGESTION_HOP_COST)
+
+/*-----------RELIABLE TRANSPORT--------------*/    // switched on by RELIABLE_DATA (AODV.h)
+#define RELIABLE_WINDOW 4       // DATA toward a node sent and not acknowledged yet
+#define SEND_WINDOW_SIZE 8      // DATA kept for retransmission, all flows together
+#define RECV_WINDOW 16          // seqs tracked from the first missing one (bits of SACK)
+#define MAX_RETRIES 4           // retransmissions before a DATA is given up
+#define RTO_INITIAL (3*CLOCK_CONF_SECOND)   // retransmission timeout before the first RTT sample
+#define RTO_MIN (CLOCK_CONF_SECOND/2)
+#define RTO_MAX (30*CLOCK_CONF_SECOND)
+#define RETRANSMIT_TICK (CLOCK_CONF_SECOND/4)
+#define ACK_DELAY (CLOCK_CONF_SECOND/4)     // DATA received in order is acknowledged at most this late...
+#define ACK_EVERY 2             // ...or every this many DATA (out of order and duplicates at once)
+#define DATA_BURSTS 0           // 1: my DATA toward a node goes in bursts of BURST_LEN DATA in a row (random payloads too)
+#define BURST_LEN 32            // DATA in a burst
+#define BURST_GAP (CLOCK_CONF_SECOND/4)     // time between two DATA of a burst (the window paces it)
+#define SEQ_NEXT(s) ((s) % MAX_REQ_ID + 1)   // sequence numbers run 1..MAX_REQ_ID
+#define SEQ_DIFF(a, b) ((unsigned int)(((unsigned long)(a) + MAX_REQ_ID - (b)) % MAX_REQ_ID))  // a - b on that circle
+
+/*-----------ROUTE REQUEST SCOPE-------------*/
+#define ROUTE_REQ_TTL MAX_NODES // TTL of a ROUTE_REQ issued by the source (whole network)
+#define LOCAL_ADD_TTL 2         // extra hops allowed to a local repair over the broken route length
+#define ID_NEW 0                // checkId results: newer than any id seen from the source
+#define ID_SAME 1               // equal to the newest one
+#define ID_LATE 2               // older, inside the window and not seen yet
+#define ID_SEEN 3               // older and already seen, or too old to tell
+
+/*-----------TRANSMIT QUEUE------------------*/
+#define TX_POOL_SIZE 8          // frames waiting for the radio
+#ifdef CSMA_CONF_MAX_MAC_TRANSMISSIONS
+#define CSMA_MAX_MAC_TRANSMISSIONS CSMA_CONF_MAX_MAC_TRANSMISSIONS
+#else
+#define CSMA_MAX_MAC_TRANSMISSIONS 3    // csma.c default
+#endif
+#define MAC_CYCLE (CLOCK_CONF_SECOND / NETSTACK_RDC_CHANNEL_CHECK_RATE)   // a ContikiMAC unicast strobes up to one cycle
+#define MAC_MAX_BACKOFF (4*MAC_CYCLE)  // CSMA backoff before a retry: one cycle plus up to three random ones
+#define MAC_MAX_TX_TIME (CSMA_MAX_MAC_TRANSMISSIONS * (MAC_CYCLE + MAC_MAX_BACKOFF))    // worst case of a frame
+#define TX_TIMEOUT (MAC_MAX_TX_TIME + MAC_CYCLE)    // radio considered free if the MAC does not report back
+#define TX_STUCK_TIME 10        // a connection whose frame is never reported is released after this long
+#define FRAME_DATA 0            // frame types (one connection each)
+#define FRAME_RREQ 1
+#define FRAME_RREP 2
+#define FRAME_RERR 3
+#define FRAME_BEACON 4
+#define FRAME_TYPES 5
+#define TX_PRIO(type) ((type) == FRAME_RERR ? FRAME_RREP : (type) == FRAME_BEACON ? FRAME_RREQ : (type))  // higher first
+
+/*-----------PACKET TRACE--------------------*/
+#define PACKET_TRACE 0          // 1: every frame sent or received is logged for tools/trace2pcap.py
+#define TRACE_TX 0
+#define TRACE_RX 1
+
+/*-----------PROFILING-----------------------*/
+#define PROFILING 0             // 1: time handlers and table operations (dumped with the button)
+#define PROF_RREQ_CB 0          // profiled code
+#define PROF_RREP_CB 1
+#define PROF_DATA_CB 2
+#define PROF_RERR_CB 3
+#define PROF_BEACON_CB 4
+#define PROF_PACKET2RREQ 5
+#define PROF_PACKET2RREP 6
+#define PROF_PACKET2DATA 7
+#define PROF_PACKET2RERR 8
+#define PROF_UPDATE_TABLES 9
+#define PROF_DUPLICATE_REQ 10
+#define PROF_AGING 11
+#define PROF_TRANSMIT 12
+#define PROF_PRINT_TABLE 13
+#define PROF_PRINTF 14
+#define PROF_COUNT 15
+#define PROFILE_TICK_CYCLES (F_CPU / RTIMER_SECOND)   // CPU cycles per rtimer tick (about 119 on sky): resolution of the profile
+#if PROFILING
+#define PROFILE_BEGIN(id) profileBegin(id)
+#define PROFILE_END(id) profileEnd(id, 0)
+#define PROFILED(id, call) (profileBegin(id), profileEnd(id, (call)))
+#else
+#define PROFILE_BEGIN(id)
+#define PROFILE_END(id)
+#define PROFILED(id, call) (call)
+#endif
+
+/*-----------PERSISTENCE---------------------*/
+#define CHECKPOINT_FILE "aodv_routes"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_SIZE (5 + 3*MAX_NODES)   // version, req_id (2), boot epoch, count, {dest, next, hops} per route
+#define REQ_ID_RESTORE_JUMP 1024    // req_id skip at restore, covers requests sent after the last checkpoint
+
+
+/**************************************************************************/
+/*-------------------------DATA STRUCTURES--------------------------------*/
+
+// transmit queue entry (frame waiting for the radio), sized by the packets of struct2packet.h
+struct TX_FRAME_ENTRY{
+    char packet[TX_FRAME_LEN];
+    int len;
+    int type;       // kind of packet, selects connection and priority
+    int next;       // receiver (unicast only)
+    unsigned int seq;   // enqueue order, FIFO within the same priority
+    struct DATA_PACKET data_pkg;    // DATA content (for local repair)
+    int valid;
+};
 
 
 /**************************************************************************/
@@ -45,29 +205,74 @@
 static void route_reply_callback(struct unicast_conn *, const rimeaddr_t *);
 static void data_callback(struct unicast_conn *, const rimeaddr_t *);
 static void route_request_callback(struct broadcast_conn *, const rimeaddr_t *);
+static void route_error_callback(struct broadcast_conn *, const rimeaddr_t *);
+static void beacon_callback(struct broadcast_conn *, const rimeaddr_t *);
+static void data_sent_callback(struct unicast_conn *, int, int);
+static void rrep_sent_callback(struct unicast_conn *, int, int);
+static void broadcast_sent_callback(struct broadcast_conn *, int, int);
 
 // Communication functions
 static void sendrrep(struct RREP_PACKET* rrep, int next);
-static void senddata(struct DATA_PACKET* data, int next);
+static char senddata(struct DATA_PACKET* data, int next);
+static void routeData(struct DATA_PACKET* data);
 static void sendrreq(struct RREQ_PACKET* rreq);
+static void sendrerr(struct RERR_PACKET* rerr);
+static void sendbeacon(struct RREP_PACKET* beacon);
+static char txEnqueue(int type, char* packet, int len, int next);
+static struct TX_FRAME_ENTRY* txDequeue();
+static char txAllowed(struct TX_FRAME_ENTRY* frame);
+static struct TX_FRAME_ENTRY* txSent(int type);
+static void printTxStats();
+static void rfTune();
 
 // Tables support functions
 static char updateTables(struct RREP_PACKET * rrep, int from);
+static void updateNeighbor(int from);
+static int getLifetime(int next);
+static void linkFailed(int next, int alive);
+static char takeCredit(int next);
+static int getLoad();
 static int getNext(int dest);
+static void confirmRoute(int dest, int next);
 // static void addEntryToRoutingTable(int dest);
 static void addEntryToDiscoveryTable(struct DISCOVERY_TABLE_ENTRY* rreq_info);
 // static int getrrepSender(struct RREP_PACKET* rrep);
 static void clearDiscoveryEntry(struct RREP_PACKET* rrep);
 static char isDuplicateReq(struct RREQ_PACKET* rreq);
+static int checkId(struct REQ_CACHE_ENTRY* entry, unsigned int epoch, unsigned int id);
 static char enque(struct DATA_PACKET* data);
+static char startDiscovery(int dest, int ttl);
+static void dropLink(int broken);
+static void localRepair(int broken, struct DATA_PACKET* data);
+static unsigned int getGroupMask(int group);
+static unsigned int sendGroupData(struct DATA_PACKET* data);
+
+// reliable transport functions
+static char reliableSend(struct DATA_PACKET* data);
+static char reliableRecv(struct DATA_PACKET* data);
+static void reliableAck(struct DATA_PACKET* data);
+static void fillAck(struct DATA_PACKET* data);
+static void sendack(int dest);
+
+// Persistence functions
+static void saveRoutes();
+static char loadRoutes();
 
 // Support functions
 static void getRandomPayload(char payload[DATA_PAYLOAD_LEN]);
+static void tracePacket(int dir, int peer, int channel, const char* packet, int len);
+#if PROFILING
+static void profileBegin(int id);
+static int profileEnd(int id, int result);
+#endif
 
 // Visualization functions
 static void printRoutingTable();
 static void printDiscoveryTable();
 static void printWaitingTable();
+static void printGroupStats();
+static void printReliableStats();
+static void printProfile();
 
 
 /**************************************************************************/
@@ -78,12 +283,24 @@ PROCESS(rreq_handler, "Handle RREQ_PACKET messages");
 PROCESS(data_handler, "Creates and sends new DATA");
 PROCESS(aging, "Controls the expiration of all tables");
 PROCESS(debugger_handler, "Enables/disables the debugger if button is clicked");
+PROCESS(checkpointer, "Periodically saves the routing state to flash");
+PROCESS(transmitter, "Hands queued frames to the radio, by priority");
+PROCESS(group_joiner, "Periodically announces membership to my group");
+PROCESS(sink_beacon, "Periodically floods the sink beacon (sink only)");
+PROCESS(rf_scheduler, "Switches between control and data radio frequencies");
+PROCESS(retransmitter, "Retransmits reliable DATA not acknowledged in time");
 
 AUTOSTART_PROCESSES(&initializer,
                     &rreq_handler, 
                     &data_handler,
                     &aging,
-                    &debugger_handler);
+                    &debugger_handler,
+                    &checkpointer,
+                    &transmitter,
+                    &group_joiner,
+                    &sink_beacon,
+                    &rf_scheduler,
+                    &retransmitter);
 
 
 /**************************************************************************/
@@ -96,16 +313,88 @@ static char dbg = 0;
 static struct unicast_conn rrep_conn;
 static struct unicast_conn data_conn;
 static struct broadcast_conn rreq_conn;
+static struct broadcast_conn rerr_conn;
+static struct broadcast_conn beacon_conn;
 
 // Callbacks
-static const struct unicast_callbacks rrep_cbk = {route_reply_callback};
-static const struct unicast_callbacks data_cbk = {data_callback};
-static const struct broadcast_callbacks rreq_cbk = {route_request_callback};
+static const struct unicast_callbacks rrep_cbk = {route_reply_callback, rrep_sent_callback};
+static const struct unicast_callbacks data_cbk = {data_callback, data_sent_callback};
+static const struct broadcast_callbacks rreq_cbk = {route_request_callback, broadcast_sent_callback};
+static const struct broadcast_callbacks rerr_cbk = {route_error_callback, broadcast_sent_callback};
+static const struct broadcast_callbacks beacon_cbk = {beacon_callback, broadcast_sent_callback};
 
 // Routing Tables
 static struct ROUTING_TABLE_ENTRY routingTable[MAX_NODES];
 static struct DISCOVERY_TABLE_ENTRY discoveryTable[DISCO_SIZE];
 static struct QUEUE_ENTRY waitingTable[MAX_DATA_IN_QUEUE];
+static struct REQ_CACHE_ENTRY reqCache[MAX_NODES];
+static struct LINK_TABLE_ENTRY linkTable[MAX_NODES];
+static int discoveryPending[MAX_NODES];     // time left before a new ROUTE_REQ toward dest is allowed
+static int repairPending[MAX_NODES];        // time left to the local repair toward dest
+
+// Transmit queue
+static struct TX_FRAME_ENTRY txPool[TX_POOL_SIZE];
+static unsigned int txSeq = 0;
+static int txWaiting = -1;  // connection whose MAC report (or TX_TIMEOUT) the transmitter waits for
+static struct TX_FRAME_ENTRY txInFlight[FRAME_TYPES];   // frame in the MAC on each connection
+static int txInFlightAge[FRAME_TYPES];      // seconds since it was handed to the MAC
+static unsigned int txDataLost = 0;         // DATA frames evicted from the transmit queue
+
+// Sink beacons (rounds heard from each sink)
+static struct REQ_CACHE_ENTRY beaconCache[MAX_NODES];
+
+// Radio schedule
+static char rfSynced = 0;           // following the control/data schedule
+static char rfDataSlot = 0;         // current slot is the data one
+static clock_time_t rfSlotEnd;      // end of the current slot
+static int rfChannel = CONTROL_RF_CHANNEL;  // channel the radio is tuned to
+static clock_time_t rfBeaconDelay;  // time the last SINK_NODE beacon took to get here
+static int rfPeerSync[MAX_NODES];   // time left to the schedule of a neighbor (it relayed a beacon)
+
+// Groups
+static int groupMembership[MAX_GROUPS][MAX_NODES]; // time left to the membership of a node
+
+// Group statistics (DATA frames per delivered group message vs repeated unicast)
+static unsigned int groupDataSent = 0;      // group messages generated here
+static unsigned int groupDataTx = 0;        // group DATA frames transmitted here
+static unsigned int groupDataRecv = 0;      // group messages delivered here
+static unsigned int unicastEquivalent = 0;  // frames repeated unicast would need for my messages
+                                            // (members counted when the DATA toward them leaves)
+
+// Congestion control
+static int dataDelta = DATA_PACKAGE_DELTA_TIME;    // current DATA generation period
+static char congestionSeen = 0;     // congestion met since the last DATA generation
+
+// Reliable transport
+static struct SEND_WINDOW_ENTRY sendWindow[SEND_WINDOW_SIZE];
+static struct FLOW_ENTRY flowTable[MAX_NODES];
+static struct DATA_PACKET ackPkt;
+static unsigned int relDataSent = 0;    // reliable DATA generated here
+static unsigned int relRetx = 0;        // retransmissions
+static unsigned int relLost = 0;        // DATA given up after MAX_RETRIES
+static unsigned int relRecv = 0;        // reliable DATA delivered here (duplicates excluded)
+
+// Profiling
+#if PROFILING
+static struct PROFILE_ENTRY profile[PROF_COUNT];
+static rtimer_clock_t profileStart[PROF_COUNT];
+static const char* profileName[PROF_COUNT] = {
+    "route_request_callback", "route_reply_callback", "data_callback",
+    "route_error_callback", "beacon_callback",
+    "packet2rreq", "packet2rrep", "packet2data", "packet2rerr",
+    "updateTables", "isDuplicateReq", "aging sweep", "transmit frame",
+    "printRoutingTable", "printf Sending DATA"};
+#endif
+
+// Route discovery
+static unsigned int req_id = 1; // next req_id of my ROUTE_REQ
+
+// Boot epoch: numbers my reliable flows apart from those of my previous boots
+static unsigned int bootEpoch;
+static char epochSaved = 0;     // bootEpoch is on flash: no later boot may reuse it
+
+// Persistence
+static char checkpointDirty = 0;  // routes or req_id moved on since the last checkpoint
 
 
 /**************************************************************************/
@@ -121,6 +410,8 @@ PROCESS_THREAD(initializer, ev, data)
         unicast_close(&rrep_conn);
         unicast_close(&data_conn);
         broadcast_close(&rreq_conn);
+        broadcast_close(&rerr_conn);
+        broadcast_close(&beacon_conn);
     }); 
         
     PROCESS_BEGIN();
@@ -130,8 +421,17 @@ PROCESS_THREAD(initializer, ev, data)
         routingTable[i].dest = i+1;
         routingTable[i].valid = 0;
         routingTable[i].hops = INF;
+        flowTable[i].rto = RTO_INITIAL;
     }
 
+    // warm restart: reload routes saved before reboot (and the epoch of that boot)
+    bootEpoch = 1 + random_rand() % MAX_EPOCH;
+    if(loadRoutes())
+        printRoutingTable();
+    // the new epoch goes to flash with the next checkpoint, not at every boot
+    // (reliableSend saves it earlier if a flow needs it)
+    checkpointDirty = 1;
+
     // Route Reply
     unicast_open(&rrep_conn, RREP_CHANNEL, &rrep_cbk);
 
@@ -145,6 +445,14 @@ PROCESS_THREAD(initializer, ev, data)
     broadcast_open(&rreq_conn, RREQ_CHANNEL, &rreq_cbk); 
     if(dbg) printf("Now listening to ROUTE_REQ  messages on channel: %d \n", RREQ_CHANNEL);
 
+    // Route Error
+    broadcast_open(&rerr_conn, RERR_CHANNEL, &rerr_cbk);
+    if(dbg) printf("Now listening to ROUTE_ERROR messages on channel: %d \n", RERR_CHANNEL);
+
+    // Sink Beacon
+    broadcast_open(&beacon_conn, BEACON_CHANNEL, &beacon_cbk);
+    if(dbg) printf("Now listening to SINK beacons on channel: %d \n", BEACON_CHANNEL);
+
     printf("Node initialized\n");
 
     PROCESS_END();
@@ -171,6 +479,8 @@ PROCESS_THREAD(rreq_handler, ev, data)
         rreq.req_id = rreq_info->req_id;
         rreq.src = rreq_info->src;
         rreq.dest = rreq_info->dest;
+        rreq.ttl = rreq_info->ttl;
+        rreq.epoch = rreq_info->epoch;
                      
         addEntryToDiscoveryTable(rreq_info);    //create entry in routing discovery table
         
@@ -188,11 +498,10 @@ PROCESS_THREAD(data_handler, ev, data)
     static struct etimer et;
     static int initial_delay;
         
-    static int req_id = 1; //starting req_id
     static int dest;
-    static int next;
+    static int burstLeft = 0;
+    static char sent;
         
-    static struct DISCOVERY_TABLE_ENTRY rreq_info;
     static struct DATA_PACKET data_pkg;
             
     PROCESS_BEGIN();
@@ -205,63 +514,67 @@ PROCESS_THREAD(data_handler, ev, data)
     {
         leds_off(LEDS_GREEN);
                 
-        PROCESS_WAIT_EVENT_UNTIL(ev != sensors_event);
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
 
         leds_on(LEDS_GREEN);
                 
-        //case data_handler TIMER, i.e. data has to be generated
-        if(ev == PROCESS_EVENT_TIMER)
-        {
-            if(dbg) printf("Process that sends DATA is awake!\n");
+        if(dbg) printf("Process that sends DATA is awake!\n");
 
-            //get a random destination node, but not this one
-            dest = 1 + random_rand() % MAX_NODES;
-            if(dest==rimeaddr_node_addr.u8[0])              //not same node
-                dest = (dest!=MAX_NODES)? dest+1 : 1;   //last node
-            
-            getRandomPayload(data_pkg.payload);    
-            if(dbg) printf("Ready to send DATA message to %d: {%s}\n",
-                        dest, data_pkg.payload);
-
-            // wait for 30 secs before sending a new mex
-            etimer_set(&et, CLOCK_CONF_SECOND * DATA_PACKAGE_DELTA_TIME);
-        } 
-        // case the event is generated by the data message CALLBACK, i.e. forward of data package
-        else
+        //get a random destination node (or group), but not this node; a burst keeps its own
+        if(burstLeft == 0)
         {
-            dest = ((struct DATA_PACKET*)data)->dest;
-            strcpy(data_pkg.payload,((struct DATA_PACKET*)data)->payload);
+            dest = 1 + random_rand() % DATA_DESTS;
+            if(dest==rimeaddr_node_addr.u8[0])              //not same node
+                dest = (dest!=DATA_DESTS)? dest+1 : 1;   //last address
+            if(DATA_BURSTS && RELIABLE_DATA && IS_NODE(dest))
+                burstLeft = BURST_LEN;
         }
-        // set 
-        data_pkg.dest = dest;
 
-        //gets the NEXT hop to destination "dest"
-        next = getNext(dest);
-        
-        // route available, send immediately
-        if(next!=0)
+        data_pkg.dest = dest;
+        // group: reach all its known members but me
+        data_pkg.src = rimeaddr_node_addr.u8[0];
+        data_pkg.epoch = bootEpoch;
+        data_pkg.ack_epoch = 0;
+        data_pkg.seq = 0;
+        data_pkg.ack = 0;
+        data_pkg.sack = 0;
+        data_pkg.mask = 0;
+        if(IS_GROUP(dest))
         {
-            senddata(&data_pkg, next);
+            data_pkg.mask = getGroupMask(dest) & ~NODE_BIT(rimeaddr_node_addr.u8[0]);
+            groupDataSent++;
         }
-        // route not avalable
+        
+        getRandomPayload(data_pkg.payload);    
+        if(dbg) printf("Ready to send DATA message to %d: {%s}\n",
+                    dest, data_pkg.payload);
+
+        // reliable flow: number it and keep a copy until acknowledged
+        // (a burst tries again when it did not fit in the window)
+        sent = !(RELIABLE_DATA && IS_NODE(dest)) || reliableSend(&data_pkg);
+        if(sent && burstLeft > 0)
+            burstLeft--;
+
+        // burst going on: next DATA soon
+        if(burstLeft > 0)
+            etimer_set(&et, BURST_GAP);
         else
         {
-            // enque data package
-            enque(&data_pkg);
-
-            //configuring parameter for the ROUTE_REQ...
-            rreq_info.req_id = req_id;
-            rreq_info.src = rimeaddr_node_addr.u8[0]; // me
-            rreq_info.dest = dest;
-            rreq_info.snd = rimeaddr_node_addr.u8[0]; // me
-                        
-            //calls the rreq_handler PROCESS in order to
-            process_post(&rreq_handler, PROCESS_EVENT_CONTINUE, &rreq_info);
-
-            // imcrement req_id
-            req_id = (req_id<99) ? req_id+1 : 1;
+            // rate control: slow down quickly on congestion, speed up slowly otherwise
+            if(congestionSeen != 0 || getLoad() >= CONGESTION_LOAD)
+                dataDelta = (2*dataDelta < MAX_DATA_DELTA_TIME) ? 2*dataDelta : MAX_DATA_DELTA_TIME;
+            else if(dataDelta > DATA_PACKAGE_DELTA_TIME)
+                dataDelta = (dataDelta - DATA_DELTA_STEP > DATA_PACKAGE_DELTA_TIME) ? dataDelta - DATA_DELTA_STEP : DATA_PACKAGE_DELTA_TIME;
+            congestionSeen = 0;
+            if(dbg && dataDelta != DATA_PACKAGE_DELTA_TIME)
+                printf("Congestion: next DATA in %d secs\n", dataDelta);
+
+            // wait before sending a new mex
+            etimer_set(&et, CLOCK_CONF_SECOND * dataDelta);
         }
 
+        if(sent != 0)
+            routeData(&data_pkg);
     }
     PROCESS_END();
 }
@@ -273,6 +586,7 @@ PROCESS_THREAD(aging, ev, data)
     static struct etimer et;
     static int i, flag;
     static int dest, next;
+    static struct RERR_PACKET rerr;
     
     PROCESS_BEGIN();
     
@@ -285,6 +599,7 @@ PROCESS_THREAD(aging, ev, data)
         PROCESS_WAIT_EVENT_UNTIL(ev != sensors_event);
         
         leds_off(LEDS_RED);
+        PROFILE_BEGIN(PROF_AGING);
         
         // Clean routingTable
         flag = 0;
@@ -293,12 +608,23 @@ PROCESS_THREAD(aging, ev, data)
             if(routingTable[i].age > 0 && routingTable[i].valid ==1)
             {
                 routingTable[i].age --;
+                routingTable[i].alive ++;
                 // if age has run out (route too old)
                 if(routingTable[i].age == 0)
                 {
+                    // DATA went through the route until it expired: trust the link longer
+                    // (a silent expiry says nothing about the link)
+                    next = routingTable[i].next;
+                    if(routingTable[i].used != 0)
+                    {
+                        linkTable[next-1].lifetime += linkTable[next-1].lifetime/2;
+                        if(linkTable[next-1].lifetime > MAX_ROUTE_LIFETIME)
+                            linkTable[next-1].lifetime = MAX_ROUTE_LIFETIME;
+                    }
                     routingTable[i].valid = 0;
                     routingTable[i].next= 0;
                     routingTable[i].hops = INF;
+                    checkpointDirty = 1;
                     printf("route to %d has expired!\n",i+1);
                     leds_on(LEDS_RED);
                     flag++;
@@ -314,20 +640,84 @@ PROCESS_THREAD(aging, ev, data)
         {
             if(discoveryTable[i].age > 0 && discoveryTable[i].valid ==1)
             {
+                discoveryTable[i].age --;
                 // if age has run out (route request too old)
                 if(discoveryTable[i].age == 0)
                 {
                     discoveryTable[i].valid = 0;
-                    printf("ROUTE_REQUEST from %d to %d (ID:%d) has expired!\n",
+                    printf("ROUTE_REQUEST from %d to %d (ID:%u) has expired!\n",
                             discoveryTable[i].src, discoveryTable[i].dest, discoveryTable[i].req_id);
                     flag++;
                 }
-                discoveryTable[i].age --;
             }
         }
         if (flag != 0)
             printDiscoveryTable();
 
+        // Release connections whose frame the MAC never reported
+        for(i=0; i<FRAME_TYPES; i++)
+        {
+            if(txInFlight[i].valid != 0 && ++txInFlightAge[i] >= TX_STUCK_TIME)
+            {
+                printf("No MAC report on connection %d: released\n", i);
+                txInFlight[i].valid = 0;
+                process_poll(&transmitter);
+                process_poll(&rf_scheduler);
+            }
+        }
+
+        // Age the radio schedule of neighbors
+        for(i=0; i<MAX_NODES; i++)
+        {
+            if(rfPeerSync[i] > 0)
+                rfPeerSync[i]--;
+        }
+
+        // Release pending discoveries
+        for(i=0; i<MAX_NODES; i++)
+        {
+            if(discoveryPending[i] > 0)
+                discoveryPending[i]--;
+        }
+
+        // Age group memberships
+        for(i=0; i<MAX_GROUPS*MAX_NODES; i++)
+        {
+            if(groupMembership[i/MAX_NODES][i%MAX_NODES] > 0)
+                groupMembership[i/MAX_NODES][i%MAX_NODES]--;
+        }
+
+        // Check local repairs: on failure tell upstream nodes
+        for(i=0; i<MAX_NODES; i++)
+        {
+            if(repairPending[i] > 0)
+            {
+                repairPending[i]--;
+                if(repairPending[i] == 0 && getNext(i+1) == 0)
+                {
+                    rerr.dest = i+1;
+                    printf("Local repair toward %d failed!\n", i+1);
+                    sendrerr(&rerr);
+                }
+            }
+        }
+
+        // Hop by hop backpressure: AIMD window toward every neighbor
+        for(i=0; i<MAX_NODES; i++)
+        {
+            if(linkTable[i].valid != 0)
+            {
+                if(linkTable[i].load >= CONGESTION_LOAD)
+                    linkTable[i].cwnd = (linkTable[i].cwnd > 1) ? linkTable[i].cwnd/2 : 1;
+                else if(linkTable[i].cwnd < MAX_CWND)
+                    linkTable[i].cwnd++;
+                linkTable[i].credit = linkTable[i].cwnd;
+                // forget old load reports little by little
+                if(linkTable[i].load > 0)
+                    linkTable[i].load--;
+            }
+        }
+
         // Refresh waiting table
         flag = 0;
         for(i=0; i<MAX_DATA_IN_QUEUE; i++)
@@ -336,9 +726,18 @@ PROCESS_THREAD(aging, ev, data)
             {
                 dest = waitingTable[i].data_pkg.dest;
                 next = getNext(dest);
+                // group: send to the members reachable now
+                if (IS_GROUP(dest))
+                {
+                    waitingTable[i].data_pkg.mask = sendGroupData(&waitingTable[i].data_pkg);
+                    next = (waitingTable[i].data_pkg.mask == 0) ? dest : 0;
+                }
+                else if (next != 0 && senddata(&waitingTable[i].data_pkg, next) == 0)
+                    next = 0;   // held back, retry next time
+
                 if (next != 0)
                 {
-                    senddata(&waitingTable[i].data_pkg, next);
+                    waitingTable[i].valid = 0;
                     if (dbg) printf("DATA sent towards %d via %d\n", dest, next);
                     flag++;
                 }
@@ -356,6 +755,8 @@ PROCESS_THREAD(aging, ev, data)
         }
         if (flag != 0)
             printWaitingTable();
+
+        PROFILE_END(PROF_AGING);
     }
     PROCESS_END();
 }
@@ -372,6 +773,271 @@ PROCESS_THREAD(debugger_handler, ev, data)
     {
         PROCESS_WAIT_EVENT_UNTIL(ev == sensors_event && data == &button_sensor);
         dbg = dbg==0 ? 1 : 0;
+        printGroupStats();
+        printReliableStats();
+        printProfile();
+        printTxStats();
+    }
+    PROCESS_END();
+}
+
+
+//This process periodically saves the routing state to flash (only if it changed)
+PROCESS_THREAD(checkpointer, ev, data)
+{
+    static struct etimer et;
+
+    PROCESS_BEGIN();
+
+    while(1)
+    {
+        etimer_set(&et, CLOCK_CONF_SECOND * CHECKPOINT_TIME);
+
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+
+        if(checkpointDirty != 0)
+            saveRoutes();
+    }
+    PROCESS_END();
+}
+
+
+//This process hands the queued frames to the radio, one at a time and by priority
+PROCESS_THREAD(transmitter, ev, data)
+{
+    static struct etimer et;
+    static struct TX_FRAME_ENTRY* frame;
+    static rimeaddr_t to_rimeaddr;
+
+    PROCESS_BEGIN();
+
+    while(1)
+    {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL || ev == PROCESS_EVENT_TIMER);
+
+        // no news from the MAC: do not stall the other connections, the late
+        // callback is still matched to its frame (one frame per connection)
+        if(ev == PROCESS_EVENT_TIMER && txWaiting >= 0)
+        {
+            if(dbg) printf("Transmission timeout\n");
+            txWaiting = -1;
+        }
+
+        // radio free: send the most urgent frame
+        if(txWaiting < 0 && (frame = txDequeue()) != NULL)
+        {
+            PROFILE_BEGIN(PROF_TRANSMIT);
+            to_rimeaddr.u8[0] = frame->next;
+            to_rimeaddr.u8[1] = 0;
+            packetbuf_clear();
+            packetbuf_copyfrom(frame->packet, frame->len);
+            txWaiting = frame->type;
+            txInFlight[frame->type] = *frame;
+            txInFlightAge[frame->type] = 0;
+            etimer_set(&et, TX_TIMEOUT);
+
+            tracePacket(TRACE_TX, frame->next,
+                    frame->type == FRAME_DATA ? DATA_CHANNEL :
+                    frame->type == FRAME_RREP ? RREP_CHANNEL :
+                    frame->type == FRAME_RREQ ? RREQ_CHANNEL :
+                    frame->type == FRAME_BEACON ? BEACON_CHANNEL : RERR_CHANNEL,
+                    frame->packet, frame->len);
+
+            if(frame->type == FRAME_DATA)
+                unicast_send(&data_conn, &to_rimeaddr);
+            else if(frame->type == FRAME_RREP)
+                unicast_send(&rrep_conn, &to_rimeaddr);
+            else if(frame->type == FRAME_RREQ)
+                broadcast_send(&rreq_conn);
+            else if(frame->type == FRAME_BEACON)
+                broadcast_send(&beacon_conn);
+            else
+                broadcast_send(&rerr_conn);
+            frame->valid = 0;
+            PROFILE_END(PROF_TRANSMIT);
+        }
+    }
+    PROCESS_END();
+}
+
+
+//This process periodically floods a join (ROUTE_REQ toward the group address)
+//so that every node learns that I belong to MY_GROUP
+PROCESS_THREAD(group_joiner, ev, data)
+{
+    static struct etimer et;
+
+    PROCESS_BEGIN();
+
+    // no group traffic: nothing to announce
+    if(GROUP_TRAFFIC == 0)
+        PROCESS_EXIT();
+
+    // Introduces randomicity to reduce conflicts at beginning
+    etimer_set(&et, CLOCK_CONF_SECOND * (1 + random_rand() % GROUP_JOIN_TIME));
+
+    while(1)
+    {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+
+        if(dbg) printf("Announcing membership to group %d\n", MY_GROUP);
+        startDiscovery(MY_GROUP, ROUTE_REQ_TTL);
+
+        etimer_set(&et, CLOCK_CONF_SECOND * GROUP_JOIN_TIME);
+    }
+    PROCESS_END();
+}
+
+
+//This process makes the sink flood a beacon (an unsolicited ROUTE_REPLY) that
+//installs and refreshes the route toward the sink on every node
+PROCESS_THREAD(sink_beacon, ev, data)
+{
+    static struct etimer et;
+    static struct RREP_PACKET beacon;
+
+    PROCESS_BEGIN();
+
+    // not the sink: nothing to do
+    if(rimeaddr_node_addr.u8[0] != SINK_NODE)
+        PROCESS_EXIT();
+
+    beacon.req_id = 1;
+    beacon.dest = SINK_NODE;
+    beacon.src = SINK_NODE;
+    beacon.hops = 0;
+
+    while(1)
+    {
+        etimer_set(&et, CLOCK_CONF_SECOND * SINK_BEACON_TIME);
+
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+
+        // a beacon starts the control slot of everyone
+        process_post_synch(&rf_scheduler, PROCESS_EVENT_CONTINUE, NULL);
+        beacon.epoch = bootEpoch;
+        beacon.load = 0;
+        sendbeacon(&beacon);
+        beacon.req_id = (beacon.req_id<MAX_REQ_ID) ? beacon.req_id+1 : 1;
+    }
+    PROCESS_END();
+}
+
+
+//This process alternates the radio between CONTROL_RF_CHANNEL and DATA_RF_CHANNEL.
+//Every SINK_NODE beacon round (re)starts the control slot, back-dated by the time the
+//beacon took to get here, which keeps nodes aligned; a node out of sync stays on
+//CONTROL_RF_CHANNEL and sends everything there. The channel never changes under a
+//frame in flight: the switch waits for its MAC report (txSent polls this process)
+PROCESS_THREAD(rf_scheduler, ev, data)
+{
+    static struct etimer et;
+    static struct etimer sync;
+
+    PROCESS_BEGIN();
+
+    // single frequency
+    if(MULTI_CHANNEL == 0 || SINK_NODE == 0)
+        PROCESS_EXIT();
+
+    cc2420_set_channel(CONTROL_RF_CHANNEL);
+
+    while(1)
+    {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE || ev == PROCESS_EVENT_TIMER
+                                    || ev == PROCESS_EVENT_POLL);
+
+        // beacon round: control slot started when the sink sent it
+        if(ev == PROCESS_EVENT_CONTINUE)
+        {
+            if(rfSynced == 0)
+                printf("Radio schedule synchronized\n");
+            rfSynced = 1;
+            rfDataSlot = 0;
+            rfSlotEnd = clock_time() + RF_CONTROL_SLOT - (data != NULL ? *(clock_time_t*)data : 0);
+            etimer_set(&sync, CLOCK_CONF_SECOND * RF_SYNC_TIMEOUT);
+        }
+        // beacons lost: back to single frequency
+        else if(ev == PROCESS_EVENT_TIMER && data == &sync)
+        {
+            printf("Radio schedule lost\n");
+            rfSynced = 0;
+            rfDataSlot = 0;
+            etimer_stop(&et);
+        }
+        // end of slot: the next one is due from the schedule, not from now
+        else if(ev == PROCESS_EVENT_TIMER && data == &et && rfSynced != 0)
+        {
+            rfDataSlot = !rfDataSlot;
+            rfSlotEnd += rfDataSlot ? RF_CYCLE - RF_CONTROL_SLOT : RF_CONTROL_SLOT;
+        }
+
+        if(rfSynced != 0 && ev != PROCESS_EVENT_POLL)
+            etimer_set(&et, CLOCK_LT(clock_time(), rfSlotEnd) ? rfSlotEnd - clock_time() : 1);
+        rfTune();
+        process_poll(&transmitter);
+    }
+    PROCESS_END();
+}
+
+
+//This process retransmits the reliable DATA not acknowledged within the RTO of
+//its flow, doubling the timeout at every retry, and sends the delayed acknowledgements
+PROCESS_THREAD(retransmitter, ev, data)
+{
+    static struct etimer et;
+    static struct DATA_PACKET retx;
+    static unsigned long timeout;
+    static int i, peer;
+
+    PROCESS_BEGIN();
+
+    // unreliable DATA only: nothing to do
+    if(RELIABLE_DATA == 0)
+        PROCESS_EXIT();
+
+    while(1)
+    {
+        etimer_set(&et, RETRANSMIT_TICK);
+
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+
+        for(i=0; i<SEND_WINDOW_SIZE; i++)
+        {
+            if(sendWindow[i].valid == 0)
+                continue;
+            peer = sendWindow[i].data_pkg.dest;
+            timeout = (unsigned long)flowTable[peer-1].rto << sendWindow[i].retries;
+            if(timeout > RTO_MAX)
+                timeout = RTO_MAX;
+            if((clock_time_t)(clock_time() - sendWindow[i].sent) < timeout)
+                continue;
+
+            // too many attempts: give it up
+            if(sendWindow[i].retries >= MAX_RETRIES)
+            {
+                printf("DATA seq %u to %d lost\n", sendWindow[i].data_pkg.seq, peer);
+                sendWindow[i].valid = 0;
+                relLost++;
+                continue;
+            }
+
+            sendWindow[i].retries++;
+            sendWindow[i].sent = clock_time();
+            relRetx++;
+            retx = sendWindow[i].data_pkg;
+            fillAck(&retx);
+            if(dbg) printf("Retransmitting DATA seq %u to %d (attempt %d)\n",
+                        retx.seq, peer, sendWindow[i].retries+1);
+            routeData(&retx);
+        }
+
+        // acknowledgements no DATA of mine could carry
+        for(i=0; i<MAX_NODES; i++)
+        {
+            if(flowTable[i].unacked > 0 && !CLOCK_LT(clock_time(), (clock_time_t)flowTable[i].ack_time))
+                sendack(i+1);
+        }
     }
     PROCESS_END();
 }
@@ -383,20 +1049,29 @@ PROCESS_THREAD(debugger_handler, ev, data)
 // called upon receiving a packet on RREP_CHANNEL
 static void route_reply_callback(struct unicast_conn *c, const rimeaddr_t *from)
 {
-    char packet[RREP_PACKET_LEN];
+    char packet[RREP_PACKET_LEN+1];
     struct RREP_PACKET rrep;
-    int i;
+    int i, len;
     
-    strncpy(packet, (char *)packetbuf_dataptr(), RREP_PACKET_LEN);
+    PROFILE_BEGIN(PROF_RREP_CB);
+
+    len = packetbuf_datalen() < RREP_PACKET_LEN ? packetbuf_datalen() : RREP_PACKET_LEN;
+    memcpy(packet, packetbuf_dataptr(), len);
+    packet[len] = '\0';
+
+    tracePacket(TRACE_RX, from->u8[0], RREP_CHANNEL, packet, len);
+
+    // sender is a direct neighbor
+    updateNeighbor(from->u8[0]);
     
     // case ROUTE_REPLY package received 
-    if(packet2rrep(packet, &rrep)!=0)
+    if(PROFILED(PROF_PACKET2RREP, packet2rrep(packet, len, &rrep))!=0 && IS_NODE(rrep.dest) && IS_NODE(rrep.src))
     {
-        printf("ROUTE_REPLY received from %d [ID:%d, Dest:%d, Src:%d, Hops:%d]\n",
+        printf("ROUTE_REPLY received from %d [ID:%u, Dest:%d, Src:%d, Hops:%d]\n",
                         from->u8[0], rrep.req_id, rrep.dest, rrep.src, rrep.hops);
     
         // Check if reply updates table
-        if(updateTables(&rrep, from->u8[0]))
+        if(PROFILED(PROF_UPDATE_TABLES, updateTables(&rrep, from->u8[0])))
         {
             // if the source is not me forward reply to all nodes waiting
             if(rrep.src != rimeaddr_node_addr.u8[0])
@@ -405,6 +1080,7 @@ static void route_reply_callback(struct unicast_conn *c, const rimeaddr_t *from)
                 for(i=0; i<DISCO_SIZE; i++){
                     if(discoveryTable[i].valid != 0
                         && discoveryTable[i].req_id == rrep.req_id
+                        && discoveryTable[i].epoch == rrep.epoch
                         && discoveryTable[i].dest == rrep.dest){
                             sendrrep(&rrep, discoveryTable[i].snd); 
                     }
@@ -423,6 +1099,8 @@ static void route_reply_callback(struct unicast_conn *c, const rimeaddr_t *from)
     {
         if(dbg) printf("ERROR in ROUTE_REPLY CALLBACK: unexpected package received!\n\t content:{%s}\n",packet);
     }
+
+    PROFILE_END(PROF_RREP_CB);
 }
 
 
@@ -431,24 +1109,65 @@ static void route_reply_callback(struct unicast_conn *c, const rimeaddr_t *from)
 static void data_callback(struct unicast_conn *c, const rimeaddr_t *from)
 {
     static struct DATA_PACKET data;
-    static char packet[DATA_PACKET_LEN];
+    static char packet[DATA_PACKET_LEN+1];
+    int len;
     
-    strncpy(packet, (char *)packetbuf_dataptr(), DATA_PACKET_LEN);
+    PROFILE_BEGIN(PROF_DATA_CB);
+
+    len = packetbuf_datalen() < DATA_PACKET_LEN ? packetbuf_datalen() : DATA_PACKET_LEN;
+    memcpy(packet, packetbuf_dataptr(), len);
+    packet[len] = '\0';
+
+    tracePacket(TRACE_RX, from->u8[0], DATA_CHANNEL, packet, len);
+
+    // sender is a direct neighbor
+    updateNeighbor(from->u8[0]);
     
     // case DATA packet receive
-    if(packet2data(packet, &data) != 0)
+    if(PROFILED(PROF_PACKET2DATA, packet2data(packet, len, &data)) != 0 && (IS_NODE(data.dest) || IS_GROUP(data.dest)))
     {
+        // queue load of the sender (backpressure)
+        if(IS_NODE(from->u8[0]))
+            linkTable[from->u8[0]-1].load = data.load;
+
+        // group message: take my copy, forward the rest
+        if(IS_GROUP(data.dest))
+        {
+            if((data.mask & NODE_BIT(rimeaddr_node_addr.u8[0])) != 0)
+            {
+                printf("GROUP %d DATA RECEIVED: {%s}\n", data.dest, data.payload);
+                groupDataRecv++;
+                data.mask &= ~NODE_BIT(rimeaddr_node_addr.u8[0]);
+            }
+            if(data.mask != 0)
+                routeData(&data);
+        }
         // if the destination of the message is this node
-        if(data.dest == rimeaddr_node_addr.u8[0])
+        else if(data.dest == rimeaddr_node_addr.u8[0])
         {
-            printf("DATA RECEIVED: {%s}\n", data.payload);
+            // acknowledgement of my DATA (alone or piggybacked)
+            if(data.ack != 0 && IS_NODE(data.src))
+                reliableAck(&data);
+
+            if(data.seq == 0)
+            {
+                if(data.ack == 0)
+                    printf("DATA RECEIVED: {%s}\n", data.payload);
+            }
+            // reliable DATA: deliver it once (reliableRecv acknowledges it)
+            else if(IS_NODE(data.src))
+            {
+                if(reliableRecv(&data) != 0)
+                    printf("DATA RECEIVED: {%s} seq %u from %d\n", data.payload, data.seq, data.src);
+                else if(dbg)
+                    printf("Duplicate DATA seq %u from %d\n", data.seq, data.src);
+            }
         }   
         // otherwise
         else
         {
             if(dbg) printf("Received DATA for %d\n", data.dest);
-            //wakes up the event that handles the sending of DATA
-            process_post(&data_handler, PROCESS_EVENT_CONTINUE, &data);
+            routeData(&data);
         }
     }
     // case unexpected package received
@@ -456,6 +1175,8 @@ static void data_callback(struct unicast_conn *c, const rimeaddr_t *from)
     {
         if(dbg) printf("ERROR in DATA CALLBACK: unexpected package received!\n\tcontent:{%s}\n",packet);
     }
+
+    PROFILE_END(PROF_DATA_CB);
 }
 
 // called upon receiving a packet on RREQ_CHANNEL
@@ -464,14 +1185,24 @@ static void route_request_callback(struct broadcast_conn *c, const rimeaddr_t *f
     static struct DISCOVERY_TABLE_ENTRY rreq_info;
     static struct RREQ_PACKET rreq;
     static struct RREP_PACKET rrep;
-    static char packet[RREQ_PACKET_LEN];
+    static char packet[RREQ_PACKET_LEN+1];
+    int len;
     
-    strncpy(packet, (char *)packetbuf_dataptr(), RREQ_PACKET_LEN);
+    PROFILE_BEGIN(PROF_RREQ_CB);
+
+    len = packetbuf_datalen() < RREQ_PACKET_LEN ? packetbuf_datalen() : RREQ_PACKET_LEN;
+    memcpy(packet, packetbuf_dataptr(), len);
+    packet[len] = '\0';
+
+    tracePacket(TRACE_RX, from->u8[0], RREQ_CHANNEL, packet, len);
+
+    // sender is a direct neighbor
+    updateNeighbor(from->u8[0]);
 
     // case ROUTE_REQUEST packge received
-    if(packet2rreq(packet, &rreq) != 0)
+    if(PROFILED(PROF_PACKET2RREQ, packet2rreq(packet, len, &rreq)) != 0 && (IS_NODE(rreq.dest) || IS_GROUP(rreq.dest)) && IS_NODE(rreq.src))
     {
-        printf("ROUTE_REQUEST received from %d [ID:%d, Dest:%d, Src:%d]\n",
+        printf("ROUTE_REQUEST received from %d [ID:%u, Dest:%d, Src:%d]\n",
                         from->u8[0], rreq.req_id, rreq.dest, rreq.src);
 
         // case destination is me
@@ -481,21 +1212,40 @@ static void route_request_callback(struct broadcast_conn *c, const rimeaddr_t *f
             rrep.src = rreq.src;
             rrep.dest = rreq.dest;
             rrep.hops = 0;
+            rrep.load = 0;
+            rrep.epoch = rreq.epoch;
 
             //sends a new ROUTE_REPLY to the ROUTE_REQ sender
             sendrrep(&rrep, from->u8[0]);
                         
         }
         // case I am NOT the destination AND the ROUTE_REQ is new
-        else if(isDuplicateReq(&rreq)==0)
+        else if(PROFILED(PROF_DUPLICATE_REQ, isDuplicateReq(&rreq))==0)
         {
-            rreq_info.req_id = rreq.req_id;
-            rreq_info.src = rreq.src;
-            rreq_info.dest = rreq.dest;
-            rreq_info.snd = from->u8[0];
-                    
-            //wakes up the process to perform a ROUTE_REQ
-            process_post(&rreq_handler, PROCESS_EVENT_CONTINUE, &rreq_info);
+            // join: the source is a member of the group
+            if(IS_GROUP(rreq.dest))
+            {
+                if(dbg) printf("Node %d is member of group %d\n", rreq.src, rreq.dest);
+                groupMembership[rreq.dest - MAX_NODES - 1][rreq.src - 1] = GROUP_MEMBERSHIP_TIME;
+            }
+
+            // request scope exhausted
+            if(rreq.ttl <= 1)
+            {
+                if(dbg) printf("ROUTE_REQUEST TTL expired: not forwarded\n");
+            }
+            else
+            {
+                rreq_info.req_id = rreq.req_id;
+                rreq_info.src = rreq.src;
+                rreq_info.dest = rreq.dest;
+                rreq_info.snd = from->u8[0];
+                rreq_info.ttl = rreq.ttl - 1;
+                rreq_info.epoch = rreq.epoch;
+
+                //wakes up the process to perform a ROUTE_REQ
+                process_post(&rreq_handler, PROCESS_EVENT_CONTINUE, &rreq_info);
+            }
         }
         // case duplicated route request
         else
@@ -508,79 +1258,457 @@ static void route_request_callback(struct broadcast_conn *c, const rimeaddr_t *f
     {
         if(dbg) printf("ERROR in ROUTE_REQUEST CALLBACK: unexpected package received!\n\tcontent: {%s}\n", packet);
     }
+
+    PROFILE_END(PROF_RREQ_CB);
 }
 
 
-/*************************************************************************************/
-/*-----------------------COMMUNICATION FUNCTIOS--------------------------------------*/
+// called upon receiving a packet on RERR_CHANNEL
+static void route_error_callback(struct broadcast_conn *c, const rimeaddr_t *from)
+{
+    static struct RERR_PACKET rerr;
+    static char packet[RERR_PACKET_LEN+1];
+    int len, d;
 
-//Actually sends the ROUTE_REPLY message
-static void sendrrep(struct RREP_PACKET* rrep, int next)
-{        
-    static char packet[RREP_PACKET_LEN];
-    
-    static rimeaddr_t to_rimeaddr;
-    to_rimeaddr.u8[0]=next;
-    to_rimeaddr.u8[1]=0;
-    
-    rrep2packet(rrep, packet);
-    packetbuf_clear();
-    packetbuf_copyfrom(packet, RREP_PACKET_LEN); 
-    unicast_send(&rrep_conn, &to_rimeaddr);
-    
-    printf("Sending ROUTE_REPLY toward %d via %d [ID:%d, Dest:%d, Src:%d, Hops:%d]\n", 
-            rrep->src, next, rrep->req_id, rrep->dest, rrep->src, rrep->hops);
-}
+    PROFILE_BEGIN(PROF_RERR_CB);
 
-//Actually sends the DATA message
-static void senddata(struct DATA_PACKET* data, int next)
-{        
-    static char packet[DATA_PACKET_LEN];
-    
-    static rimeaddr_t to_rimeaddr;
-    to_rimeaddr.u8[0]=next;
-    to_rimeaddr.u8[1]=0;
-    
-    data2packet(data, packet);
-    packetbuf_clear();
-    packetbuf_copyfrom(packet, DATA_PACKET_LEN); 
-    unicast_send(&data_conn, &to_rimeaddr);
-    
-    printf("Sending DATA {%s} to %d via %d \n", 
-            data->payload, data->dest, next);
-}
+    len = packetbuf_datalen() < RERR_PACKET_LEN ? packetbuf_datalen() : RERR_PACKET_LEN;
+    memcpy(packet, packetbuf_dataptr(), len);
+    packet[len] = '\0';
 
-//Actually sends the ROUTE_REQUEST message (broadcast)
-static void sendrreq(struct RREQ_PACKET* rreq)
-{        
-    static char packet[RREQ_PACKET_LEN];
-    
-    rreq2packet(rreq, packet);
-    packetbuf_clear();
-    packetbuf_copyfrom(packet, RREQ_PACKET_LEN); 
-    broadcast_send(&rreq_conn);
-    
-    printf("Broadcasting ROUTE_REQUEST toward %d [ID:%d, Dest:%d, Src:%d]\n",
-            rreq->dest, rreq->req_id, rreq->dest, rreq->src);
-}
+    tracePacket(TRACE_RX, from->u8[0], RERR_CHANNEL, packet, len);
 
+    // sender is a direct neighbor
+    updateNeighbor(from->u8[0]);
 
-/*************************************************************************************/
-/*-----------------------TABLES SUPPORT FUNCTIOS-------------------------------------*/
+    // case ROUTE_ERROR package received
+    if(PROFILED(PROF_PACKET2RERR, packet2rerr(packet, len, &rerr)) != 0 && IS_NODE(rerr.dest))
+    {
+        printf("ROUTE_ERROR received from %d [Dest:%d]\n", from->u8[0], rerr.dest);
 
-static char updateTables(struct RREP_PACKET * rrep, int from)
+        // my route used the sender: drop it and tell my upstream nodes
+        d = rerr.dest - 1;
+        if(routingTable[d].valid != 0 && routingTable[d].next == from->u8[0])
+        {
+            linkFailed(from->u8[0], routingTable[d].alive);
+            routingTable[d].valid = 0;
+            routingTable[d].next = 0;
+            routingTable[d].hops = INF;
+            checkpointDirty = 1;
+            printRoutingTable();
+            sendrerr(&rerr);
+        }
+    }
+    // case unexpected package received
+    else
+    {
+        if(dbg) printf("ERROR in ROUTE_ERROR CALLBACK: unexpected package received!\n\tcontent: {%s}\n", packet);
+    }
+
+    PROFILE_END(PROF_RERR_CB);
+}
+
+// called upon receiving a packet on BEACON_CHANNEL
+static void beacon_callback(struct broadcast_conn *c, const rimeaddr_t *from)
 {
-    int d = rrep->dest - 1;
+    static struct RREP_PACKET beacon;
+    static char packet[RREP_PACKET_LEN+1];
+    int len, d, round, parsed;
+
+    PROFILE_BEGIN(PROF_BEACON_CB);
+
+    len = packetbuf_datalen() < RREP_PACKET_LEN ? packetbuf_datalen() : RREP_PACKET_LEN;
+    memcpy(packet, packetbuf_dataptr(), len);
+    packet[len] = '\0';
+
+    tracePacket(TRACE_RX, from->u8[0], BEACON_CHANNEL, packet, len);
 
-    //if the ROUTE_REPLY received shows a better path 
-    if(rrep->hops < routingTable[d].hops)
+    // sender is a direct neighbor
+    updateNeighbor(from->u8[0]);
+
+    parsed = PROFILED(PROF_PACKET2RREP, packet2rrep(packet, len, &beacon));
+
+    // only the nodes following the radio schedule relay its beacon (the sink too)
+    if(parsed != 0 && beacon.dest == SINK_NODE && IS_NODE(from->u8[0]))
+        rfPeerSync[from->u8[0]-1] = RF_SYNC_TIMEOUT;
+
+    // case beacon received (from another sink)
+    if(parsed != 0 && IS_NODE(beacon.dest) && beacon.dest != rimeaddr_node_addr.u8[0] && beacon.hops < INF)
     {
-        //UPDATES the routing discovery table!
+
+        d = beacon.dest - 1;
+        round = checkId(&beaconCache[d], beacon.epoch, beacon.req_id);
+        if(round == ID_NEW)
+        {
+            // new round: the fresh gradient replaces the old route, then goes on
+            if(dbg) printf("SINK beacon from %d via %d [Seq:%u, Hops:%d]\n",
+                    beacon.dest, from->u8[0], beacon.req_id, beacon.hops);
+            if(beacon.dest == SINK_NODE)
+            {
+                rfBeaconDelay = (beacon.hops + 1) * RF_HOP_DELAY;
+                process_post_synch(&rf_scheduler, PROCESS_EVENT_CONTINUE, &rfBeaconDelay);
+            }
+            routingTable[d].valid = 0;
+            routingTable[d].hops = INF;
+            PROFILED(PROF_UPDATE_TABLES, updateTables(&beacon, from->u8[0]));
+            beacon.hops = beacon.hops + 1;
+            sendbeacon(&beacon);
+        }
+        else if(round == ID_SAME)
+        {
+            // same round: keep the shortest gradient
+            PROFILED(PROF_UPDATE_TABLES, updateTables(&beacon, from->u8[0]));
+        }
+    }
+    // case unexpected package received
+    else
+    {
+        if(dbg) printf("ERROR in BEACON CALLBACK: unexpected package received!\n\tcontent: {%s}\n", packet);
+    }
+
+    PROFILE_END(PROF_BEACON_CB);
+}
+
+// called when the MAC is done with a DATA packet
+static void data_sent_callback(struct unicast_conn *c, int status, int num_tx)
+{
+    struct TX_FRAME_ENTRY* frame;
+    int i;
+
+    // not the DATA in flight (already released): nothing to say about it
+    if((frame = txSent(FRAME_DATA)) == NULL)
+        return;
+
+    // next hop did not acknowledge: link is broken
+    if(status == MAC_TX_NOACK)
+    {
+        // the next hop may just be listening on the other channel: try again later
+        if(RF_PEER_UNSYNCED(frame->next))
+        {
+            printf("No answer from %d off the radio schedule: DATA queued\n", frame->next);
+            enque(&frame->data_pkg);
+            return;
+        }
+        printf("Link to %d broken after %d attempts!\n", frame->next, num_tx);
+        // forwarded DATA is repaired here, my own DATA looks for a new route from scratch
+        if(frame->data_pkg.src != rimeaddr_node_addr.u8[0])
+            localRepair(frame->next, &frame->data_pkg);
+        else
+        {
+            dropLink(frame->next);
+            enque(&frame->data_pkg);
+            if(IS_NODE(frame->data_pkg.dest))
+                startDiscovery(frame->data_pkg.dest, ROUTE_REQ_TTL);
+        }
+    }
+    // next hop answered: the route(s) just used are alive
+    else if(status == MAC_TX_OK)
+    {
+        if(IS_NODE(frame->data_pkg.dest))
+            confirmRoute(frame->data_pkg.dest, frame->next);
+        else
+        {
+            for(i=1; i<=MAX_NODES; i++)
+            {
+                if((frame->data_pkg.mask & NODE_BIT(i)) != 0)
+                    confirmRoute(i, frame->next);
+            }
+        }
+    }
+}
+
+// called when the MAC is done with a ROUTE_REPLY
+static void rrep_sent_callback(struct unicast_conn *c, int status, int num_tx)
+{
+    txSent(FRAME_RREP);
+}
+
+// called when the MAC is done with a ROUTE_REQUEST, ROUTE_ERROR or beacon
+static void broadcast_sent_callback(struct broadcast_conn *c, int status, int num_tx)
+{
+    if(c == &rreq_conn)
+        txSent(FRAME_RREQ);
+    else if(c == &rerr_conn)
+        txSent(FRAME_RERR);
+    else
+        txSent(FRAME_BEACON);
+}
+
+
+/*************************************************************************************/
+/*-----------------------COMMUNICATION FUNCTIOS--------------------------------------*/
+
+//Queues the ROUTE_REPLY message
+static void sendrrep(struct RREP_PACKET* rrep, int next)
+{        
+    static char packet[RREP_PACKET_LEN+1];
+    
+    if(rrep->load < getLoad())
+        rrep->load = getLoad();
+    rrep2packet(rrep, packet);
+    if(txEnqueue(FRAME_RREP, packet, RREP_PACKET_LEN, next) == 0)
+        return;
+    
+    printf("Sending ROUTE_REPLY toward %d via %d [ID:%u, Dest:%d, Src:%d, Hops:%d]\n", 
+            rrep->src, next, rrep->req_id, rrep->dest, rrep->src, rrep->hops);
+}
+
+//Queues the DATA message (0 if held back because next is congested)
+static char senddata(struct DATA_PACKET* data, int next)
+{        
+    static char packet[DATA_PACKET_LEN+1];
+    
+    if(takeCredit(next) == 0)
+    {
+        if(dbg) printf("DATA to %d held back: %d is congested\n", data->dest, next);
+        if(data->src == rimeaddr_node_addr.u8[0])
+            congestionSeen = 1;
+        return 0;
+    }
+
+    data->load = getLoad();
+    data2packet(data, packet);
+    if(txEnqueue(FRAME_DATA, packet, DATA_PACKET_LEN, next) == 0)
+        return 0;
+    // only my own flows slow down my DATA generation
+    if(linkTable[next-1].load >= CONGESTION_LOAD && data->src == rimeaddr_node_addr.u8[0])
+        congestionSeen = 1;
+    
+    PROFILE_BEGIN(PROF_PRINTF);
+    printf("Sending DATA {%s} to %d via %d \n", 
+            data->payload, data->dest, next);
+    PROFILE_END(PROF_PRINTF);
+    return 1;
+}
+
+//Sends DATA (mine or forwarded) toward its destination: queued until a route is found
+static void routeData(struct DATA_PACKET* data)
+{
+    int next;
+
+    // group, one copy per next hop: keep only members still without route
+    if(IS_GROUP(data->dest))
+    {
+        data->mask = sendGroupData(data);
+        if(data->mask != 0)
+            enque(data);
+        return;
+    }
+
+    //gets the NEXT hop to destination
+    next = getNext(data->dest);
+
+    // route available, send immediately (next hop congested: wait in the queue)
+    if(next != 0)
+    {
+        if(senddata(data, next) == 0)
+            enque(data);
+    }
+    // route not avalable
+    else
+    {
+        enque(data);
+
+        // look for a route (one ROUTE_REQ covers all data toward dest)
+        startDiscovery(data->dest, ROUTE_REQ_TTL);
+    }
+}
+
+//Queues the ROUTE_REQUEST message (broadcast)
+static void sendrreq(struct RREQ_PACKET* rreq)
+{        
+    static char packet[RREQ_PACKET_LEN+1];
+    
+    rreq2packet(rreq, packet);
+    if(txEnqueue(FRAME_RREQ, packet, RREQ_PACKET_LEN, 0) == 0)
+        return;
+    
+    printf("Broadcasting ROUTE_REQUEST toward %d [ID:%u, Dest:%d, Src:%d]\n",
+            rreq->dest, rreq->req_id, rreq->dest, rreq->src);
+}
+
+
+//Queues the ROUTE_ERROR message (broadcast)
+static void sendrerr(struct RERR_PACKET* rerr)
+{
+    static char packet[RERR_PACKET_LEN+1];
+
+    rerr2packet(rerr, packet);
+    if(txEnqueue(FRAME_RERR, packet, RERR_PACKET_LEN, 0) == 0)
+        return;
+
+    printf("Broadcasting ROUTE_ERROR [Dest:%d]\n", rerr->dest);
+}
+
+
+//Queues the sink beacon (broadcast)
+static void sendbeacon(struct RREP_PACKET* beacon)
+{
+    static char packet[RREP_PACKET_LEN+1];
+
+    if(beacon->load < getLoad())
+        beacon->load = getLoad();
+    rrep2packet(beacon, packet);
+    if(txEnqueue(FRAME_BEACON, packet, RREP_PACKET_LEN, 0) == 0)
+        return;
+
+    if(dbg) printf("Broadcasting SINK beacon [Sink:%d, Seq:%u, Hops:%d]\n",
+            beacon->dest, beacon->req_id, beacon->hops);
+}
+
+
+/*************************************************************************************/
+/*-----------------------TRANSMIT QUEUE FUNCTIOS-------------------------------------*/
+
+// Stores a frame in the transmit pool. When the pool is full the newest frame
+// of lower priority is dropped to make room, otherwise the new frame is dropped
+static char txEnqueue(int type, char* packet, int len, int next)
+{
+    int i, victim = -1;
+
+    if(len > TX_FRAME_LEN)
+        return 0;
+
+    for(i=0; i<TX_POOL_SIZE; i++)
+    {
+        if(txPool[i].valid == 0)
+        {
+            victim = i;
+            break;
+        }
+        if(TX_PRIO(txPool[i].type) < TX_PRIO(type)
+            && (victim < 0 || TX_PRIO(txPool[i].type) < TX_PRIO(txPool[victim].type)
+                || (TX_PRIO(txPool[i].type) == TX_PRIO(txPool[victim].type)
+                    && (int)(txPool[i].seq - txPool[victim].seq) > 0)))
+            victim = i;
+    }
+    if(victim < 0)
+    {
+        printf("Transmit queue full: frame dropped!\n");
+        return 0;
+    }
+    if(txPool[victim].valid != 0)
+    {
+        if(txPool[victim].type == FRAME_DATA)
+        {
+            printf("Transmit queue full: DATA to %d via %d lost!\n",
+                    txPool[victim].data_pkg.dest, txPool[victim].next);
+            txDataLost++;
+        }
+        else
+            printf("Transmit queue full: lower priority frame dropped!\n");
+    }
+
+    memcpy(txPool[victim].packet, packet, len);
+    txPool[victim].len = len;
+    txPool[victim].type = type;
+    txPool[victim].next = next;
+    txPool[victim].seq = txSeq++;
+    if(type == FRAME_DATA)
+        packet2data(packet, len, &txPool[victim].data_pkg);
+    txPool[victim].valid = 1;
+
+    process_poll(&transmitter);
+    return 1;
+}
+
+// Gets the oldest frame of the highest priority (NULL if the pool is empty)
+static struct TX_FRAME_ENTRY* txDequeue()
+{
+    int i;
+    struct TX_FRAME_ENTRY* best = NULL;
+
+    for(i=0; i<TX_POOL_SIZE; i++)
+    {
+        if(txPool[i].valid != 0 && txInFlight[txPool[i].type].valid == 0 && txAllowed(&txPool[i])
+            && (best == NULL || TX_PRIO(txPool[i].type) > TX_PRIO(best->type)
+                || (TX_PRIO(txPool[i].type) == TX_PRIO(best->type) && (int)(txPool[i].seq - best->seq) < 0)))
+            best = &txPool[i];
+    }
+    return best;
+}
+
+// Checks that a frame may be sent now (radio schedule). DATA goes in the data
+// slot, unless its next hop does not follow the schedule: then in the control one
+static char txAllowed(struct TX_FRAME_ENTRY* frame)
+{
+    char data;
+
+    // channel switch still waiting for a frame in flight
+    if(rfChannel != RF_SLOT_CHANNEL())
+        return 0;
+    if(rfSynced == 0)
+        return 1;
+    if(CLOCK_LT(rfSlotEnd, clock_time() + RF_GUARD))
+        return 0;
+    data = frame->type == FRAME_DATA && IS_NODE(frame->next) && rfPeerSync[frame->next-1] > 0;
+    return data == (rfDataSlot != 0);
+}
+
+// Tunes the radio to the channel of the current slot, unless a frame is still
+// in flight on the old one
+static void rfTune()
+{
+    int i;
+
+    if(rfChannel == RF_SLOT_CHANNEL())
+        return;
+    for(i=0; i<FRAME_TYPES; i++)
+    {
+        if(txInFlight[i].valid != 0)
+        {
+            if(dbg) printf("Channel switch deferred: frame in flight on connection %d\n", i);
+            return;
+        }
+    }
+    rfChannel = RF_SLOT_CHANNEL();
+    cc2420_set_channel(rfChannel);
+}
+
+// The MAC reported back on the connection of "type": frees it and returns the
+// frame it carried (NULL if none is in flight, e.g. released by TX_STUCK_TIME)
+static struct TX_FRAME_ENTRY* txSent(int type)
+{
+    if(txInFlight[type].valid == 0)
+    {
+        if(dbg) printf("Stale MAC report on connection %d ignored\n", type);
+        return NULL;
+    }
+    txInFlight[type].valid = 0;
+    if(txWaiting == type)
+        txWaiting = -1;
+    process_poll(&transmitter);
+    process_poll(&rf_scheduler);
+    return &txInFlight[type];
+}
+
+
+/*************************************************************************************/
+/*-----------------------TABLES SUPPORT FUNCTIOS-------------------------------------*/
+
+static char updateTables(struct RREP_PACKET * rrep, int from)
+{
+    int d = rrep->dest - 1;
+
+    //if the ROUTE_REPLY received shows a better path (or confirms the current one)
+    if(ROUTE_COST(rrep->hops, rrep->load) < ROUTE_COST(routingTable[d].hops, routingTable[d].load)
+        || (routingTable[d].valid != 0 && routingTable[d].next == from
+            && ROUTE_COST(rrep->hops, rrep->load) == ROUTE_COST(routingTable[d].hops, routingTable[d].load)))
+    {
+        //UPDATES the routing discovery table!
         routingTable[d].dest = rrep->dest;
         routingTable[d].hops = rrep->hops;             
+        routingTable[d].load = rrep->load;
+        if(routingTable[d].valid == 0 || routingTable[d].next != from)
+        {
+            routingTable[d].alive = 0;
+            routingTable[d].used = 0;
+        }
         routingTable[d].next = from;
-        routingTable[d].age = ROUTE_EXPIRATION_TIME;
+        routingTable[d].age = getLifetime(from);
+        routingTable[d].restored = 0;
         routingTable[d].valid = 1;
+        checkpointDirty = 1;
         if(dbg) printf("Improved ROUTE to %d: %d HOPS!\n",
                 rrep->dest, rrep->hops);
         printRoutingTable();
@@ -589,6 +1717,103 @@ static char updateTables(struct RREP_PACKET * rrep, int from)
     return 0;
 }
 
+// Installs (or refreshes) a 1-hop route toward a node that was just heard
+static void updateNeighbor(int from)
+{
+    int d = from - 1;
+    int rssi;
+
+    if(from < 1 || from > MAX_NODES || from == rimeaddr_node_addr.u8[0])
+        return;
+
+    // link quality history
+    rssi = (signed char)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+    if(linkTable[d].valid == 0)
+    {
+        linkTable[d].lifetime = ROUTE_EXPIRATION_TIME;
+        linkTable[d].rssi = rssi;
+        linkTable[d].cwnd = MAX_CWND;
+        linkTable[d].credit = MAX_CWND;
+        linkTable[d].valid = 1;
+    }
+    else
+        linkTable[d].rssi = (3*linkTable[d].rssi + rssi) / 4;
+
+    // already known as neighbor, only refresh
+    if(routingTable[d].valid != 0 && routingTable[d].hops == 0)
+    {
+        routingTable[d].age = getLifetime(from);
+        routingTable[d].restored = 0;
+        return;
+    }
+
+    routingTable[d].dest = from;
+    routingTable[d].hops = 0;
+    routingTable[d].load = 0;
+    routingTable[d].next = from;
+    routingTable[d].age = getLifetime(from);
+    routingTable[d].alive = 0;
+    routingTable[d].used = 0;
+    routingTable[d].restored = 0;
+    routingTable[d].valid = 1;
+    checkpointDirty = 1;
+    if(dbg) printf("New NEIGHBOR %d: direct ROUTE installed!\n", from);
+    printRoutingTable();
+}
+
+// Lifetime of a route through next: learned from past breaks, halved on weak links
+static int getLifetime(int next)
+{
+    int lifetime;
+
+    if(linkTable[next-1].valid == 0)
+        return ROUTE_EXPIRATION_TIME;
+
+    lifetime = linkTable[next-1].lifetime;
+    if(linkTable[next-1].rssi < WEAK_LINK_RSSI)
+        lifetime = lifetime / 2;
+    return (lifetime < MIN_ROUTE_LIFETIME) ? MIN_ROUTE_LIFETIME : lifetime;
+}
+
+// A route through next broke after "alive" seconds: move the lifetime toward it
+static void linkFailed(int next, int alive)
+{
+    if(linkTable[next-1].valid == 0)
+        return;
+    linkTable[next-1].lifetime = (linkTable[next-1].lifetime + alive) / 2;
+    if(linkTable[next-1].lifetime < MIN_ROUTE_LIFETIME)
+        linkTable[next-1].lifetime = MIN_ROUTE_LIFETIME;
+    if(dbg) printf("Link to %d unstable: route lifetime now %d\n", next, linkTable[next-1].lifetime);
+}
+
+// Consumes a DATA credit toward next (0 if its window is used up)
+static char takeCredit(int next)
+{
+    if(linkTable[next-1].valid == 0)
+        return 1;
+    if(linkTable[next-1].credit <= 0)
+        return 0;
+    linkTable[next-1].credit--;
+    return 1;
+}
+
+// Gets the number of DATA frames waiting here (queue and radio)
+static int getLoad()
+{
+    int i, load = 0;
+    for(i=0; i<MAX_DATA_IN_QUEUE; i++)
+    {
+        if(waitingTable[i].valid != 0)
+            load++;
+    }
+    for(i=0; i<TX_POOL_SIZE; i++)
+    {
+        if(txPool[i].valid != 0 && txPool[i].type == FRAME_DATA)
+            load++;
+    }
+    return load;
+}
+
 // Gets the next node for the given destination
 static int getNext(int dest)
 {
@@ -597,6 +1822,22 @@ static int getNext(int dest)
     return 0;
 }
 
+// A route that delivered DATA to its next hop is in use (and valid again if restored)
+static void confirmRoute(int dest, int next)
+{
+    struct ROUTING_TABLE_ENTRY* route = &routingTable[dest-1];
+
+    if(route->valid == 0 || route->next != next)
+        return;
+    route->used = 1;
+    if(route->restored != 0)
+    {
+        route->age = getLifetime(next);
+        route->restored = 0;
+        if(dbg) printf("Restored ROUTE to %d confirmed\n", dest);
+    }
+}
+
 // adds if(dbg) ic entry to discovery table.
 static void addEntryToDiscoveryTable(struct DISCOVERY_TABLE_ENTRY* rreq_info)
 {
@@ -607,8 +1848,10 @@ static void addEntryToDiscoveryTable(struct DISCOVERY_TABLE_ENTRY* rreq_info)
             discoveryTable[i].src = rreq_info->src;
             discoveryTable[i].dest = rreq_info->dest;
             discoveryTable[i].snd = rreq_info->snd;
+            discoveryTable[i].epoch = rreq_info->epoch;
             discoveryTable[i].valid = 1;
-            discoveryTable[i].age = ROUTE_DISCOVERY_TIME;
+            // one more: the next aging tick may come at any moment
+            discoveryTable[i].age = ROUTE_DISCOVERY_TIME + 1;
             break;
         }
     }
@@ -622,6 +1865,7 @@ static void clearDiscoveryEntry(struct RREP_PACKET* rrep)
     for(i=0; i<DISCO_SIZE; i++){
         if(discoveryTable[i].valid != 0
             && discoveryTable[i].req_id == rrep->req_id
+            && discoveryTable[i].epoch == rrep->epoch
             // && discoveryTable[i].src == rrep->src        // enable for ditinguish on reply id
             && discoveryTable[i].dest == rrep->dest)
                 discoveryTable[i].valid = 0;
@@ -630,18 +1874,58 @@ static void clearDiscoveryEntry(struct RREP_PACKET* rrep)
     return;
 }
 
-// Checks if the received ROUTE_REQ was already in the discovery Table
+// Checks if the received ROUTE_REQ was already seen (sliding window per source)
 static char isDuplicateReq(struct RREQ_PACKET* rreq)
-{        
-    int i;
-    for(i=0; i<DISCO_SIZE; i++){
-        if(discoveryTable[i].valid != 0
-            && discoveryTable[i].req_id == rreq->req_id
-            && discoveryTable[i].src == rreq->src
-            && discoveryTable[i].dest == rreq->dest)
-                return 1;
+{
+    int result;
+
+    // my own requests coming back
+    if(rreq->src == rimeaddr_node_addr.u8[0])
+        return 1;
+    if(rreq->src < 1 || rreq->src > MAX_NODES)
+        return 1;
+
+    result = checkId(&reqCache[rreq->src - 1], rreq->epoch, rreq->req_id);
+    return (result == ID_SAME || result == ID_SEEN) ? 1 : 0;
+}
+
+// Classifies id against the ids already heard from a source (see ID_NEW...).
+// Ids behind the window count as seen: a late copy never resets the window.
+// A new boot epoch of the source (it restarted its counter) starts over
+static int checkId(struct REQ_CACHE_ENTRY* entry, unsigned int epoch, unsigned int id)
+{
+    unsigned int diff;
+
+    // first id from this source, or first one since it rebooted
+    if(entry->valid == 0 || entry->epoch != epoch)
+    {
+        entry->epoch = epoch;
+        entry->last_id = id;
+        entry->window = 1;
+        entry->valid = 1;
+        return ID_NEW;
+    }
+
+    diff = (id - entry->last_id) & MAX_REQ_ID;
+
+    // same as newest
+    if(diff == 0)
+        return ID_SAME;
+
+    // newer: slide the window forward
+    if(diff <= MAX_REQ_ID/2)
+    {
+        entry->window = (diff < REQ_WINDOW_SIZE) ? (entry->window << diff) | 1 : 1;
+        entry->last_id = id;
+        return ID_NEW;
     }
-    return 0;        
+
+    // older: check it inside the window
+    diff = (entry->last_id - id) & MAX_REQ_ID;
+    if(diff >= REQ_WINDOW_SIZE || (entry->window & (1UL << diff)) != 0)
+        return ID_SEEN;
+    entry->window |= 1UL << diff;
+    return ID_LATE;
 }
 
 // Adds data package to queue
@@ -652,12 +1936,422 @@ static char enque(struct DATA_PACKET* data)
         if(waitingTable[i].valid == 0) {
             waitingTable[i].data_pkg = *data;
             waitingTable[i].age = MAX_QUEUEING_TIME;
+            waitingTable[i].valid = 1;
             return 1;
         }
     }
     return 0;
 }
 
+// Posts a ROUTE_REQ toward dest, unless one is already pending
+static char startDiscovery(int dest, int ttl)
+{
+    // few slots: several discoveries may be posted before rreq_handler runs
+    static struct DISCOVERY_TABLE_ENTRY rreq_info[4];
+    static int slot = 0;
+
+    // a ROUTE_REQ toward dest is already on its way
+    if(IS_NODE(dest) && discoveryPending[dest-1] > 0)
+    {
+        if(dbg) printf("ROUTE_REQUEST toward %d already pending\n", dest);
+        return 0;
+    }
+
+    //configuring parameter for the ROUTE_REQ...
+    slot = (slot+1) % 4;
+    rreq_info[slot].req_id = req_id;
+    rreq_info[slot].src = rimeaddr_node_addr.u8[0]; // me
+    rreq_info[slot].dest = dest;
+    rreq_info[slot].snd = rimeaddr_node_addr.u8[0]; // me
+    rreq_info[slot].ttl = ttl;
+    rreq_info[slot].epoch = bootEpoch;
+
+    //calls the rreq_handler PROCESS in order to
+    process_post(&rreq_handler, PROCESS_EVENT_CONTINUE, &rreq_info[slot]);
+    if(IS_NODE(dest))
+        discoveryPending[dest-1] = DISCOVERY_COALESCE_TIME;
+
+    // imcrement req_id
+    req_id = (req_id<MAX_REQ_ID) ? req_id+1 : 1;
+    if(req_id % (REQ_ID_RESTORE_JUMP/2) == 0)
+        checkpointDirty = 1;
+    return 1;
+}
+
+// Drops the routes through a broken next hop
+static void dropLink(int broken)
+{
+    int i, alive = 0;
+
+    for(i=0; i<MAX_NODES; i++)
+    {
+        if(routingTable[i].valid != 0 && routingTable[i].next == broken)
+        {
+            if(routingTable[i].alive > alive)
+                alive = routingTable[i].alive;
+            routingTable[i].valid = 0;
+            routingTable[i].next = 0;
+            routingTable[i].hops = INF;
+            checkpointDirty = 1;
+        }
+    }
+    linkFailed(broken, alive);
+    printRoutingTable();
+}
+
+// Repairs the route of forwarded DATA that failed locally, with a ROUTE_REQ
+// limited to the surroundings of the break
+static void localRepair(int broken, struct DATA_PACKET* data)
+{
+    int dest, ttl;
+
+    dest = data->dest;
+    ttl = (IS_NODE(dest) && routingTable[dest-1].hops < INF) ? routingTable[dest-1].hops + 1 + LOCAL_ADD_TTL : ROUTE_REQ_TTL;
+    dropLink(broken);
+
+    // keep the DATA until the repair is over
+    enque(data);
+
+    // group DATA: members left without route are rediscovered when the queue is flushed
+    if(IS_GROUP(dest))
+        return;
+
+    if(repairPending[dest-1] == 0)
+        repairPending[dest-1] = LOCAL_REPAIR_TIME;
+    startDiscovery(dest, ttl > ROUTE_REQ_TTL ? ROUTE_REQ_TTL : ttl);
+}
+
+
+// Gets the known members of a group (bit n-1 for node n)
+static unsigned int getGroupMask(int group)
+{
+    int i;
+    unsigned int mask = 0;
+    for(i=0; i<MAX_NODES; i++)
+    {
+        if(groupMembership[group - MAX_NODES - 1][i] > 0)
+            mask |= NODE_BIT(i+1);
+    }
+    return mask;
+}
+
+// Sends a single copy of group DATA to every next hop, carrying the members
+// reached through it. Returns the members with no route (discovery started)
+static unsigned int sendGroupData(struct DATA_PACKET* data)
+{
+    static struct DATA_PACKET part;
+    unsigned int left = data->mask, unreached = 0;
+    int i, j, next, cost;
+
+    part = *data;
+    for(i=1; i<=MAX_NODES; i++)
+    {
+        if((left & NODE_BIT(i)) == 0)
+            continue;
+        next = getNext(i);
+        if(next == 0)
+        {
+            unreached |= NODE_BIT(i);
+            left &= ~NODE_BIT(i);
+            startDiscovery(i, ROUTE_REQ_TTL);
+            continue;
+        }
+        // all members sharing this next hop
+        part.mask = 0;
+        for(j=i; j<=MAX_NODES; j++)
+        {
+            if((left & NODE_BIT(j)) != 0 && getNext(j) == next)
+                part.mask |= NODE_BIT(j);
+        }
+        left &= ~part.mask;
+        if(senddata(&part, next) != 0)
+        {
+            // repeated unicast from the source: one message per member, over its route
+            cost = 0;
+            if(data->src == rimeaddr_node_addr.u8[0])
+            {
+                for(j=1; j<=MAX_NODES; j++)
+                {
+                    if((part.mask & NODE_BIT(j)) != 0)
+                        cost += routingTable[j-1].hops + 1;
+                }
+                unicastEquivalent += cost;
+            }
+            groupDataTx++;
+            printf("GROUP %d FRAME via %d: unicast %d\n", data->dest, next, cost);
+        }
+        else
+            unreached |= part.mask;     // next hop congested: retry later
+    }
+    return unreached;
+}
+
+
+/*************************************************************************************/
+/*-----------------------RELIABLE TRANSPORT FUNCTIOS---------------------------------*/
+
+// Numbers new DATA toward a node and keeps a copy for retransmission
+// (0 if the window of the flow or the retransmission buffer is full)
+static char reliableSend(struct DATA_PACKET* data)
+{
+    struct FLOW_ENTRY* flow = &flowTable[data->dest-1];
+    int i, free = -1, outstanding = 0;
+
+    for(i=0; i<SEND_WINDOW_SIZE; i++)
+    {
+        if(sendWindow[i].valid == 0)
+            free = i;
+        else if(sendWindow[i].data_pkg.dest == data->dest)
+            outstanding++;
+    }
+    if(free < 0 || outstanding >= RELIABLE_WINDOW)
+    {
+        printf("Window toward %d full: DATA discarded\n", data->dest);
+        return 0;
+    }
+
+    // first DATA numbered in this epoch: a reboot must not restart it
+    if(epochSaved == 0)
+        saveRoutes();
+
+    flow->last_seq = SEQ_NEXT(flow->last_seq);
+    data->seq = flow->last_seq;
+    fillAck(data);
+    sendWindow[free].data_pkg = *data;
+    sendWindow[free].sent = clock_time();
+    sendWindow[free].retries = 0;
+    sendWindow[free].valid = 1;
+    relDataSent++;
+    return 1;
+}
+
+// Records reliable DATA received from data->src (0 if it is a duplicate).
+// In order DATA is acknowledged every ACK_EVERY or after ACK_DELAY, the rest at once
+static char reliableRecv(struct DATA_PACKET* data)
+{
+    struct FLOW_ENTRY* flow = &flowTable[data->src-1];
+    unsigned int diff;
+    char fresh = 0;
+
+    // first DATA of the source since it booted: its flow starts from seq 1
+    if(flow->epoch != data->epoch)
+    {
+        if(flow->epoch != 0)
+            printf("Node %d restarted: new flow from seq 1\n", data->src);
+        flow->epoch = data->epoch;
+        flow->expected = 1;
+        flow->received = 0;
+        flow->unacked = 0;
+    }
+
+    // behind the window: already delivered
+    diff = SEQ_DIFF(data->seq, flow->expected);
+    if(diff < MAX_REQ_ID/2)
+    {
+        if(diff >= RECV_WINDOW)
+        {
+            // the source gave up older DATA: slide the window up to this one
+            diff -= RECV_WINDOW - 1;
+            flow->received = (diff < RECV_WINDOW) ? flow->received >> diff : 0;
+            flow->expected = ((unsigned long)flow->expected + diff - 1) % MAX_REQ_ID + 1;
+            diff = RECV_WINDOW - 1;
+        }
+        if((flow->received & (1U << diff)) == 0)
+        {
+            flow->received |= 1U << diff;
+            while((flow->received & 1) != 0)
+            {
+                flow->received >>= 1;
+                flow->expected = SEQ_NEXT(flow->expected);
+            }
+            relRecv++;
+            fresh = 1;
+        }
+    }
+
+    if(fresh != 0 && diff == 0 && flow->received == 0 && ++flow->unacked < ACK_EVERY)
+    {
+        if(flow->unacked == 1)
+            flow->ack_time = clock_time() + ACK_DELAY;
+    }
+    else
+        sendack(data->src);
+    return fresh;
+}
+
+// Frees the DATA toward data->src acknowledged by data->ack (cumulative)
+// and data->sack (selective), updating the RTT estimate of the flow
+static void reliableAck(struct DATA_PACKET* data)
+{
+    struct FLOW_ENTRY* flow = &flowTable[data->src-1];
+    unsigned int diff;
+    int i, rtt, err;
+
+    // acknowledges DATA of one of my previous boots
+    if(data->ack_epoch != bootEpoch)
+    {
+        if(dbg) printf("Stale acknowledgement from %d ignored\n", data->src);
+        return;
+    }
+
+    for(i=0; i<SEND_WINDOW_SIZE; i++)
+    {
+        if(sendWindow[i].valid == 0 || sendWindow[i].data_pkg.dest != data->src)
+            continue;
+        diff = SEQ_DIFF(sendWindow[i].data_pkg.seq, data->ack);
+        if(diff < MAX_REQ_ID/2 && (diff >= RECV_WINDOW || (data->sack & (1U << diff)) == 0))
+            continue;
+
+        // RTT sample, only from DATA sent once (Karn)
+        if(sendWindow[i].retries == 0)
+        {
+            rtt = (clock_time_t)(clock_time() - sendWindow[i].sent);
+            if(flow->srtt == 0)
+            {
+                flow->srtt = rtt;
+                flow->rttvar = rtt/2;
+            }
+            else
+            {
+                err = (flow->srtt > rtt) ? flow->srtt - rtt : rtt - flow->srtt;
+                flow->rttvar = (3*flow->rttvar + err)/4;
+                flow->srtt = (7*flow->srtt + rtt)/8;
+            }
+            flow->rto = flow->srtt + 4*flow->rttvar;
+            if(flow->rto < RTO_MIN)
+                flow->rto = RTO_MIN;
+            else if(flow->rto > RTO_MAX)
+                flow->rto = RTO_MAX;
+        }
+        if(dbg) printf("DATA seq %u to %d acknowledged\n", sendWindow[i].data_pkg.seq, data->src);
+        sendWindow[i].valid = 0;
+    }
+}
+
+// Piggybacks on DATA toward data->dest what I received from it
+static void fillAck(struct DATA_PACKET* data)
+{
+    struct FLOW_ENTRY* flow = &flowTable[data->dest-1];
+
+    data->ack_epoch = flow->epoch;
+    data->ack = (flow->epoch != 0) ? flow->expected : 0;
+    data->sack = (flow->epoch != 0) ? flow->received : 0;
+    flow->unacked = 0;
+}
+
+// Sends a DATA with no payload acknowledging the DATA received from dest
+static void sendack(int dest)
+{
+    ackPkt.dest = dest;
+    ackPkt.src = rimeaddr_node_addr.u8[0];
+    ackPkt.epoch = bootEpoch;
+    ackPkt.seq = 0;
+    ackPkt.mask = 0;
+    ackPkt.payload[0] = '\0';
+    fillAck(&ackPkt);
+    routeData(&ackPkt);
+}
+
+
+/*************************************************************************************/
+/*-----------------------PERSISTENCE FUNCTIOS----------------------------------------*/
+
+// Writes valid routes and current req_id to flash, skipping identical checkpoints
+static void saveRoutes()
+{
+    static unsigned char buf[CHECKPOINT_SIZE];
+    static unsigned char last[CHECKPOINT_SIZE];
+    static char reserved = 0;
+    int i, n = 0, fd;
+
+    buf[0] = CHECKPOINT_VERSION;
+    buf[1] = req_id & 0xFF;
+    buf[2] = (req_id >> 8) & 0xFF;
+    buf[3] = bootEpoch;
+    for(i=0; i<MAX_NODES; i++)
+    {
+        if(routingTable[i].valid != 0)
+        {
+            buf[5 + 3*n] = routingTable[i].dest;
+            buf[6 + 3*n] = routingTable[i].next;
+            buf[7 + 3*n] = routingTable[i].hops;
+            n++;
+        }
+    }
+    buf[4] = n;
+    memset(buf + 5 + 3*n, 0, CHECKPOINT_SIZE - 5 - 3*n);
+    checkpointDirty = 0;
+
+    // same content already on flash
+    if(memcmp(buf, last, CHECKPOINT_SIZE) == 0)
+        return;
+
+    // fixed size file: Coffee rewrites it in place through its micro log
+    if(reserved == 0)
+    {
+        cfs_coffee_reserve(CHECKPOINT_FILE, CHECKPOINT_SIZE);
+        reserved = 1;
+    }
+    fd = cfs_open(CHECKPOINT_FILE, CFS_WRITE);
+    if(fd < 0)
+    {
+        printf("ERROR: unable to open %s for writing\n", CHECKPOINT_FILE);
+        return;
+    }
+    if(cfs_write(fd, buf, CHECKPOINT_SIZE) == CHECKPOINT_SIZE)
+    {
+        memcpy(last, buf, CHECKPOINT_SIZE);
+        epochSaved = 1;
+    }
+    cfs_close(fd);
+    if(dbg) printf("Routing state saved (%d routes, ID:%u)\n", n, req_id);
+}
+
+// Restores routes and req_id saved before reboot, and moves on to the next boot
+// epoch. Restored routes only live
+// ROUTE_REVALIDATION_TIME unless a ROUTE_REPLY, the neighbor itself or a DATA
+// acknowledged by the next hop confirms them (see confirmRoute)
+static char loadRoutes()
+{
+    static unsigned char buf[CHECKPOINT_SIZE];
+    int i, n, d, fd, len;
+
+    fd = cfs_open(CHECKPOINT_FILE, CFS_READ);
+    if(fd < 0)
+        return 0;
+    len = cfs_read(fd, buf, CHECKPOINT_SIZE);
+    cfs_close(fd);
+
+    n = buf[4];
+    if(len != CHECKPOINT_SIZE || buf[0] != CHECKPOINT_VERSION || n > MAX_NODES)
+        return 0;
+
+    // jump ahead so that neighbors do not discard my new requests as duplicates
+    req_id = ((buf[1] | (buf[2] << 8)) + REQ_ID_RESTORE_JUMP) & MAX_REQ_ID;
+    if(req_id == 0)
+        req_id = 1;
+    bootEpoch = buf[3] % MAX_EPOCH + 1;
+
+    for(i=0; i<n; i++)
+    {
+        d = buf[5 + 3*i];
+        if(!IS_NODE(d) || !IS_NODE(buf[6 + 3*i]) || buf[7 + 3*i] >= INF)
+            continue;
+        routingTable[d-1].dest = d;
+        routingTable[d-1].next = buf[6 + 3*i];
+        routingTable[d-1].hops = buf[7 + 3*i];
+        routingTable[d-1].load = 0;
+        routingTable[d-1].age = ROUTE_REVALIDATION_TIME;
+        routingTable[d-1].alive = 0;
+        routingTable[d-1].used = 0;
+        routingTable[d-1].restored = 1;
+        routingTable[d-1].valid = 1;
+    }
+    printf("Routing state restored (%d routes, ID:%u, epoch %u)\n", n, req_id, bootEpoch);
+    return 1;
+}
+
+
 /*************************************************************************************/
 /*-----------------------SUPPORT FUNCTIOS--------------------------------------*/
 
@@ -684,6 +2378,38 @@ static void getRandomPayload(char payload[DATA_PAYLOAD_LEN])
 }
 
 
+//Logs a frame as "TRACE <T|R> <peer> <rime channel> <frame>" (peer 0: broadcast),
+//the format read by tools/trace2pcap.py
+static void tracePacket(int dir, int peer, int channel, const char* packet, int len)
+{
+    if(PACKET_TRACE == 0)
+        return;
+    printf("TRACE %c %d %d %.*s\n", dir == TRACE_TX ? 'T' : 'R', peer, channel, len, packet);
+}
+
+#if PROFILING
+//Starts timing the profiled code id
+static void profileBegin(int id)
+{
+    profileStart[id] = RTIMER_NOW();
+}
+
+//Adds the time elapsed since profileBegin(id) to the statistics of id,
+//passing result through (see PROFILED)
+static int profileEnd(int id, int result)
+{
+    unsigned int ticks = (rtimer_clock_t)(RTIMER_NOW() - profileStart[id]);
+
+    if(profile[id].calls == 0 || ticks < profile[id].min)
+        profile[id].min = ticks;
+    if(ticks > profile[id].max)
+        profile[id].max = ticks;
+    profile[id].total += ticks;
+    profile[id].calls++;
+    return result;
+}
+#endif
+
 /*************************************************************************************/
 /*-----------------------VISULIZATION FUNCTIOS---------------------------------------*/
 
@@ -693,6 +2419,7 @@ static void printRoutingTable()
     int i;
     char flag = 0;
 
+    PROFILE_BEGIN(PROF_PRINT_TABLE);
     printf("Routing Table");
     for(i=0; i<MAX_NODES;i++)
     {
@@ -708,6 +2435,7 @@ static void printRoutingTable()
         printf(" is empty\n");
     else
         printf("\n");
+    PROFILE_END(PROF_PRINT_TABLE);
 }
 
 //Helps to print the Discovery Table
@@ -720,7 +2448,7 @@ static void printDiscoveryTable()
     {
         if(discoveryTable[i].valid!= 0)
         {
-            printf("\n    {ID:%d; Src:%d; Dest:%d; Snd:%d;}",
+            printf("\n    {ID:%u; Src:%d; Dest:%d; Snd:%d;}",
                     discoveryTable[i].req_id,
                     discoveryTable[i].src,
                     discoveryTable[i].dest,
@@ -734,6 +2462,57 @@ static void printDiscoveryTable()
         printf("\n");
 }
 
+// prints group delivery statistics
+static void printGroupStats()
+{
+    printf("Group stats: sent %u, frames %u, received %u, unicast would need %u frames\n",
+            groupDataSent, groupDataTx, groupDataRecv, unicastEquivalent);
+}
+
+// prints reliable transport statistics and the state of my flows
+static void printReliableStats()
+{
+    int i;
+
+    if(RELIABLE_DATA == 0)
+        return;
+    printf("Reliable stats: sent %u, retransmitted %u, lost %u, received %u\n",
+            relDataSent, relRetx, relLost, relRecv);
+    for(i=0; i<MAX_NODES; i++)
+    {
+        if(flowTable[i].last_seq != 0 || flowTable[i].epoch != 0)
+            printf("    {Node:%d; Seq:%u; SRTT:%d; RTO:%d; Epoch:%u; Expected:%u;}\n", i+1,
+                    flowTable[i].last_seq, flowTable[i].srtt, flowTable[i].rto,
+                    flowTable[i].epoch, flowTable[i].expected);
+    }
+}
+
+// prints min/avg/max CPU cycles and calls of the profiled code (callees included)
+static void printProfile()
+{
+#if PROFILING
+    int i;
+
+    // times are whole rtimer ticks: a min of 0 or an avg below one tick only says "shorter than a tick"
+    printf("Profile (cycles, resolution 1 rtimer tick = %lu cycles: shorter code reads 0 or %lu)\n",
+            (unsigned long)PROFILE_TICK_CYCLES, (unsigned long)PROFILE_TICK_CYCLES);
+    for(i=0; i<PROF_COUNT; i++)
+    {
+        if(profile[i].calls != 0)
+            printf("    {%s; Calls:%lu; Min:%lu; Avg:%lu; Max:%lu;}\n", profileName[i], profile[i].calls,
+                    (unsigned long)profile[i].min * PROFILE_TICK_CYCLES,
+                    profile[i].total * PROFILE_TICK_CYCLES / profile[i].calls,
+                    (unsigned long)profile[i].max * PROFILE_TICK_CYCLES);
+    }
+#endif
+}
+
+// prints the losses of the transmit queue
+static void printTxStats()
+{
+    printf("Transmit stats: %u DATA frames lost in the queue\n", txDataLost);
+}
+
 // prints Waiting table
 static void printWaitingTable()
 {
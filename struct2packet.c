@@ -11,101 +11,243 @@
 /*---------------------struct to packet-----------------------*/
 
 void rreq2packet(struct RREQ_PACKET* rreq, char* packet){
-    sprintf(packet, RREQ_REP, rreq->req_id, rreq->dest, rreq->src);
+    sprintf(packet, RREQ_REP, rreq->req_id, rreq->epoch, rreq->dest, rreq->src, rreq->ttl);
 }
 
 void rrep2packet(struct RREP_PACKET* rrep, char* packet){
-    sprintf(packet, RREP_REP, rrep->req_id, rrep->dest, rrep->src, rrep->hops);
+    sprintf(packet, RREP_REP, rrep->req_id, rrep->epoch, rrep->dest, rrep->src, rrep->hops, rrep->load);
+}
+
+void rerr2packet(struct RERR_PACKET* rerr, char* packet){
+    sprintf(packet, RERR_REP, rerr->dest);
 }
 
 void data2packet(struct DATA_PACKET* data, char* packet){
-    sprintf(packet, DATA_REP, data->dest, data->payload);
+    packet += sprintf(packet, DATA_BASE_REP, data->dest, data->src);
+#if RELIABLE_DATA
+    packet += sprintf(packet, DATA_RELIABLE_REP, data->epoch, data->ack_epoch, data->seq, data->ack, data->sack);
+#endif
+#if GROUP_TRAFFIC
+    packet += sprintf(packet, DATA_GROUP_REP, data->mask);
+#endif
+    sprintf(packet, DATA_TAIL_REP, data->load, data->payload);
 }
 
 
 /*---------------------packet to struct------------------------*/
 
-// read route request package
-char packet2rreq(char* packet, struct RREQ_PACKET* rreq)
+// reads a right aligned number of exactly "width" chars (leading blanks allowed)
+static char readNumber(const char* field, int width, unsigned long* value)
 {
-    static char reqId[2];
-    static char src[2];
-    static char dest[2];
-    if( strncmp(packet,RREQ_HEADER, sizeof(RREQ_HEADER)-1) == 0)
+    int i = 0;
+    *value = 0;
+    while(i < width-1 && field[i] == ' ')
+        i++;
+    for(; i<width; i++)
     {
-        // id
-        int idx = sizeof(RREQ_HEADER)-1 + sizeof(ITEM_SEP)-1 + sizeof(REQ_ID)-1 - (sizeof(ID_REP)-1);
-        reqId[0] = packet[idx];
-        reqId[1] = packet[idx+1];
-        rreq->req_id = atoi(reqId);
-        // dest
-        idx += 2 + sizeof(ITEM_SEP)-1 + sizeof(DEST)-1 - (sizeof(NODE_REP)-1);
-        dest[0] = packet[idx];
-        dest[1] = packet[idx+1];
-        rreq->dest = atoi(dest);
-        // source
-        idx += 2 + sizeof(ITEM_SEP)-1 + sizeof(SRC)-1 - (sizeof(NODE_REP)-1);
-        src[0] = packet[idx];
-        src[1] = packet[idx+1];
-        rreq->src = atoi(src);
-
-        return 1;
+        if(field[i] < '0' || field[i] > '9')
+            return 0;
+        *value = *value*10 + (field[i] - '0');
     }
-    return 0;
+    return 1;
 }
 
-// read route reply packet
-char packet2rrep(char* packet, struct RREP_PACKET* rrep)
+// reads a zero padded hexadecimal number of exactly "width" chars
+static char readHex(const char* field, int width, unsigned long* value)
 {
-    static char repId[2];
-    static char src[2];
-    static char dest[2];
-    static char hops[2];
-    if( strncmp(packet,RREP_HEADER, sizeof(RREP_HEADER)-1) == 0)
+    int i;
+    *value = 0;
+    for(i=0; i<width; i++)
     {
-        // id
-        int idx = sizeof(RREP_HEADER)-1 + sizeof(ITEM_SEP)-1 + sizeof(REP_ID)-1 - (sizeof(ID_REP)-1);
-        repId[0] = packet[idx];
-        repId[1] = packet[idx+1];
-        rrep->req_id = atoi(repId);
-        // dest
-        idx += 2 + sizeof(ITEM_SEP)-1 + sizeof(DEST)-1 - (sizeof(NODE_REP)-1);
-        dest[0] = packet[idx];
-        dest[1] = packet[idx+1];
-        rrep->dest = atoi(dest);
-        // source
-        idx += 2 + sizeof(ITEM_SEP)-1 + sizeof(SRC)-1 - (sizeof(NODE_REP)-1);
-        src[0] = packet[idx];
-        src[1] = packet[idx+1];
-        rrep->src = atoi(src);
-        // hops
-        idx += 2 + sizeof(ITEM_SEP)-1 + sizeof(HOPS)-1 - (sizeof(HOPS_REP)-1);
-        hops[0] = packet[idx];
-        hops[1] = packet[idx+1];
-        rrep->hops = atoi(hops);
-
-        return 1;
+        if(field[i] >= '0' && field[i] <= '9')
+            *value = *value*16 + (field[i] - '0');
+        else if(field[i] >= 'a' && field[i] <= 'f')
+            *value = *value*16 + (field[i] - 'a' + 10);
+        else
+            return 0;
     }
-    return 0;
+    return 1;
+}
+
+// checks the "LABEL:" preceding a value and returns the index of the value
+static int readLabel(const char* packet, int idx, const char* label, int labelLen)
+{
+    if(strncmp(packet+idx, ITEM_SEP, sizeof(ITEM_SEP)-1) != 0)
+        return -1;
+    idx += sizeof(ITEM_SEP)-1;
+    if(strncmp(packet+idx, label, labelLen) != 0)
+        return -1;
+    return idx + labelLen;
+}
+
+// read route request package
+char packet2rreq(const char* packet, int len, struct RREQ_PACKET* rreq)
+{
+    unsigned long value;
+    int idx;
+    if(len < (int)RREQ_PACKET_LEN || strncmp(packet,RREQ_HEADER, sizeof(RREQ_HEADER)-1) != 0)
+        return 0;
+
+    // id
+    idx = readLabel(packet, sizeof(RREQ_HEADER)-1, REQ_ID, sizeof(REQ_ID)-1 - (sizeof(ID_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, ID_LEN, &value) || value > MAX_REQ_ID)
+        return 0;
+    rreq->req_id = (unsigned int)value;
+    // boot epoch of the source
+    idx = readLabel(packet, idx + ID_LEN, EPOCH, sizeof(EPOCH)-1 - (sizeof(EPOCH_REP)-1));
+    if(idx < 0 || !readHex(packet+idx, EPOCH_LEN, &value))
+        return 0;
+    rreq->epoch = (unsigned int)value;
+    // dest
+    idx = readLabel(packet, idx + EPOCH_LEN, DEST, sizeof(DEST)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    rreq->dest = (int)value;
+    // source
+    idx = readLabel(packet, idx + NODE_LEN, SRC, sizeof(SRC)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    rreq->src = (int)value;
+    // time to live
+    idx = readLabel(packet, idx + NODE_LEN, TTL, sizeof(TTL)-1 - (sizeof(TTL_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, TTL_LEN, &value))
+        return 0;
+    rreq->ttl = (int)value;
+
+    return 1;
+}
+
+// read route reply packet
+char packet2rrep(const char* packet, int len, struct RREP_PACKET* rrep)
+{
+    unsigned long value;
+    int idx;
+    if(len < (int)RREP_PACKET_LEN || strncmp(packet,RREP_HEADER, sizeof(RREP_HEADER)-1) != 0)
+        return 0;
+
+    // id
+    idx = readLabel(packet, sizeof(RREP_HEADER)-1, REP_ID, sizeof(REP_ID)-1 - (sizeof(ID_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, ID_LEN, &value) || value > MAX_REQ_ID)
+        return 0;
+    rrep->req_id = (unsigned int)value;
+    // boot epoch of the id
+    idx = readLabel(packet, idx + ID_LEN, EPOCH, sizeof(EPOCH)-1 - (sizeof(EPOCH_REP)-1));
+    if(idx < 0 || !readHex(packet+idx, EPOCH_LEN, &value))
+        return 0;
+    rrep->epoch = (unsigned int)value;
+    // dest
+    idx = readLabel(packet, idx + EPOCH_LEN, DEST, sizeof(DEST)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    rrep->dest = (int)value;
+    // source
+    idx = readLabel(packet, idx + NODE_LEN, SRC, sizeof(SRC)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    rrep->src = (int)value;
+    // hops
+    idx = readLabel(packet, idx + NODE_LEN, HOPS, sizeof(HOPS)-1 - (sizeof(HOPS_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, HOPS_LEN, &value))
+        return 0;
+    rrep->hops = (int)value;
+    // load
+    idx = readLabel(packet, idx + HOPS_LEN, LOAD, sizeof(LOAD)-1 - (sizeof(LOAD_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, LOAD_LEN, &value))
+        return 0;
+    rrep->load = (int)value;
+
+    return 1;
+}
+
+// read route error packet
+char packet2rerr(const char* packet, int len, struct RERR_PACKET* rerr)
+{
+    unsigned long value;
+    int idx;
+    if(len < (int)RERR_PACKET_LEN || strncmp(packet,RERR_HEADER, sizeof(RERR_HEADER)-1) != 0)
+        return 0;
+
+    // dest
+    idx = readLabel(packet, sizeof(RERR_HEADER)-1, DEST, sizeof(DEST)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    rerr->dest = (int)value;
+
+    return 1;
 }
 
 // read data packet
-char packet2data(char* packet, struct DATA_PACKET* data)
+char packet2data(const char* packet, int len, struct DATA_PACKET* data)
 {
-    static char dest[2];
-    if( strncmp(packet, DATA_HEADER, sizeof(DATA_HEADER)-1) == 0)
-    {
-        // dest
-        int idx = sizeof(DATA_HEADER)-1 + sizeof(ITEM_SEP)-1 + sizeof(DEST)-1 - (sizeof(NODE_REP)-1);
-        dest[0] = packet[idx];
-        dest[1] = packet[idx+1];
-        data->dest = atoi(dest);
-        
-        // payload
-        idx = idx + 2 + sizeof(ITEM_SEP)-1 + sizeof(PAYLOAD)-1 - (sizeof(PAYLOAD_REP)-1);
-        strncpy(data->payload, packet+idx, DATA_PAYLOAD_LEN);
-        
-        return 1;
-    }
-    return 0;
+    unsigned long value;
+    int idx, i;
+    if(len < (int)DATA_HEADER_LEN || strncmp(packet, DATA_HEADER, sizeof(DATA_HEADER)-1) != 0)
+        return 0;
+
+    // dest
+    idx = readLabel(packet, sizeof(DATA_HEADER)-1, DEST, sizeof(DEST)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    data->dest = (int)value;
+
+    // source
+    idx = readLabel(packet, idx + NODE_LEN, SRC, sizeof(SRC)-1 - (sizeof(NODE_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, NODE_LEN, &value))
+        return 0;
+    data->src = (int)value;
+    idx += NODE_LEN;
+
+    // boot epochs of the sequence number and of the acknowledgements
+    data->epoch = data->ack_epoch = 0;
+    data->seq = data->ack = data->sack = 0;
+#if RELIABLE_DATA
+    idx = readLabel(packet, idx, EPOCH, sizeof(EPOCH)-1 - (sizeof(EPOCH_REP)-1));
+    if(idx < 0 || !readHex(packet+idx, EPOCH_LEN, &value))
+        return 0;
+    data->epoch = (unsigned int)value;
+    if(!readHex(packet+idx+EPOCH_LEN, EPOCH_LEN, &value))
+        return 0;
+    data->ack_epoch = (unsigned int)value;
+
+    // sequence number and acknowledgements
+    idx = readLabel(packet, idx + 2*EPOCH_LEN, SEQ, sizeof(SEQ)-1 - (sizeof(SEQ_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, SEQ_LEN, &value) || value > MAX_REQ_ID)
+        return 0;
+    data->seq = (unsigned int)value;
+    idx = readLabel(packet, idx + SEQ_LEN, ACK, sizeof(ACK)-1 - (sizeof(SEQ_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, SEQ_LEN, &value) || value > MAX_REQ_ID)
+        return 0;
+    data->ack = (unsigned int)value;
+    idx = readLabel(packet, idx + SEQ_LEN, SACK, sizeof(SACK)-1 - (sizeof(MASK_REP)-1));
+    if(idx < 0 || !readHex(packet+idx, MASK_LEN, &value))
+        return 0;
+    data->sack = (unsigned int)value;
+    idx += MASK_LEN;
+#endif
+
+    // group members
+    data->mask = 0;
+#if GROUP_TRAFFIC
+    idx = readLabel(packet, idx, MASK, sizeof(MASK)-1 - (sizeof(MASK_REP)-1));
+    if(idx < 0 || !readHex(packet+idx, MASK_LEN, &value))
+        return 0;
+    data->mask = (unsigned int)value;
+    idx += MASK_LEN;
+#endif
+
+    // load of the sender
+    idx = readLabel(packet, idx, LOAD, sizeof(LOAD)-1 - (sizeof(LOAD_REP)-1));
+    if(idx < 0 || !readNumber(packet+idx, LOAD_LEN, &value))
+        return 0;
+    data->load = (int)value;
+
+    // payload (up to the end of the frame, always terminated)
+    idx = readLabel(packet, idx + LOAD_LEN, PAYLOAD, sizeof(PAYLOAD)-1 - (sizeof(PAYLOAD_REP)-1));
+    if(idx < 0)
+        return 0;
+    for(i=0; i<DATA_PAYLOAD_LEN-1 && idx+i<len && packet[idx+i]!='\0'; i++)
+        data->payload[i] = packet[idx+i];
+    data->payload[i] = '\0';
+
+    return 1;
 }
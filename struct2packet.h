@@ -24,30 +24,75 @@
 #define DATA_HEADER "DATA"
 #define RREQ_HEADER "ROUTE_REQUEST"
 #define RREP_HEADER "ROUTE_REPLY"
+#define RERR_HEADER "ROUTE_ERROR"
 
 /*-------------------VALUE REPRESENTATION---------*/    // DO NOT MODIFY!!
 #define NODE_REP "%2d"      // DO NOT MODIFY!!
 #define HOPS_REP "%2d"      // DO NOT MODIFY!!
-#define ID_REP "%2d"        // DO NOT MODIFY!!
+#define ID_REP "%5u"        // DO NOT MODIFY!!
+#define TTL_REP "%2d"
+#define MASK_REP "%04x"
+#define LOAD_REP "%2d"
+#define SEQ_REP "%5u"
+#define EPOCH_REP "%02x"
 #define PAYLOAD_REP "%s"    // DO NOT MODIFY!!
 
+/*-------------------VALUE WIDTH (chars)----------*/    // printed by the representations above
+#define NODE_LEN 2
+#define HOPS_LEN 2
+#define ID_LEN 5
+#define TTL_LEN 2
+#define MASK_LEN 4
+#define LOAD_LEN 2
+#define SEQ_LEN 5
+#define EPOCH_LEN 2
+
 /*-------------------ITEM REPRESENTATION----------*/    // DO NOT MODIFY!!
 #define DEST    "DEST"    VALUES_SEP NODE_REP
 #define SRC     "SRC"     VALUES_SEP NODE_REP
 #define HOPS    "HOPS"    VALUES_SEP HOPS_REP
 #define REQ_ID  "REQ_ID"  VALUES_SEP ID_REP
 #define REP_ID  "REQ_ID"  VALUES_SEP ID_REP
+#define TTL     "TTL"     VALUES_SEP TTL_REP
+#define MASK    "MASK"    VALUES_SEP MASK_REP
+#define LOAD    "LOAD"    VALUES_SEP LOAD_REP
+#define EPOCH   "EPOCH"   VALUES_SEP EPOCH_REP
+#define EPOCHS  "EPOCH"   VALUES_SEP EPOCH_REP EPOCH_REP   // DATA: of SEQ, then of ACK
+#define SEQ     "SEQ"     VALUES_SEP SEQ_REP
+#define ACK     "ACK"     VALUES_SEP SEQ_REP
+#define SACK    "SACK"    VALUES_SEP MASK_REP
 #define PAYLOAD "PAYLOAD" VALUES_SEP PAYLOAD_REP
 
 /*-------------------PACKAGES REPRESENTATION------*/    // DO NOT MODIFY!!
-#define DATA_REP DATA_HEADER ITEM_SEP DEST   ITEM_SEP PAYLOAD
-#define RREQ_REP RREQ_HEADER ITEM_SEP REQ_ID ITEM_SEP DEST ITEM_SEP SRC ITEM_SEP
-#define RREP_REP RREP_HEADER ITEM_SEP REP_ID ITEM_SEP DEST ITEM_SEP SRC ITEM_SEP HOPS ITEM_SEP
+#define DATA_BASE_REP DATA_HEADER ITEM_SEP DEST ITEM_SEP SRC
+#if RELIABLE_DATA
+#define DATA_RELIABLE_REP ITEM_SEP EPOCHS ITEM_SEP SEQ ITEM_SEP ACK ITEM_SEP SACK
+#else
+#define DATA_RELIABLE_REP ""
+#endif
+#if GROUP_TRAFFIC
+#define DATA_GROUP_REP ITEM_SEP MASK
+#else
+#define DATA_GROUP_REP ""
+#endif
+#define DATA_TAIL_REP ITEM_SEP LOAD ITEM_SEP PAYLOAD
+#define DATA_REP DATA_BASE_REP DATA_RELIABLE_REP DATA_GROUP_REP DATA_TAIL_REP   // items of disabled features left out
+#define RREQ_REP RREQ_HEADER ITEM_SEP REQ_ID ITEM_SEP EPOCH ITEM_SEP DEST ITEM_SEP SRC ITEM_SEP TTL ITEM_SEP
+#define RREP_REP RREP_HEADER ITEM_SEP REP_ID ITEM_SEP EPOCH ITEM_SEP DEST ITEM_SEP SRC ITEM_SEP HOPS ITEM_SEP LOAD ITEM_SEP
+#define RERR_REP RERR_HEADER ITEM_SEP DEST   ITEM_SEP
 
 /*-------------------PACKAGES LENGTH--------------*/    // DO NOT MODIFY!!
-#define DATA_PACKET_LEN sizeof(DATA_REP)-1 - 3 + DATA_PAYLOAD_LEN
-#define RREQ_PACKET_LEN sizeof(RREQ_REP)-1 - 3
-#define RREP_PACKET_LEN sizeof(RREP_REP)-1 - 4
+#define DATA_RELIABLE_LEN (sizeof(DATA_RELIABLE_REP)-1 + (RELIABLE_DATA ? 2*(EPOCH_LEN - (sizeof(EPOCH_REP)-1)) \
+                           + 2*(SEQ_LEN - (sizeof(SEQ_REP)-1)) + MASK_LEN - (sizeof(MASK_REP)-1) : 0))
+#define DATA_GROUP_LEN (sizeof(DATA_GROUP_REP)-1 + (GROUP_TRAFFIC ? MASK_LEN - (sizeof(MASK_REP)-1) : 0))
+#define DATA_HEADER_LEN (sizeof(DATA_BASE_REP)-1 - 2 + DATA_RELIABLE_LEN + DATA_GROUP_LEN \
+                         + sizeof(DATA_TAIL_REP)-1 - 3)     // DATA packet without payload
+#define DATA_PACKET_LEN (DATA_HEADER_LEN + DATA_PAYLOAD_LEN)
+#define RREQ_PACKET_LEN (sizeof(RREQ_REP)-1 - 3 + ID_LEN - (sizeof(ID_REP)-1) + EPOCH_LEN - (sizeof(EPOCH_REP)-1))
+#define RREP_PACKET_LEN (sizeof(RREP_REP)-1 - 4 + ID_LEN - (sizeof(ID_REP)-1) + EPOCH_LEN - (sizeof(EPOCH_REP)-1))
+#define RERR_PACKET_LEN (sizeof(RERR_REP)-1 - 1)
+#define MAX_LEN(a, b) ((a) > (b) ? (a) : (b))
+#define TX_FRAME_LEN (MAX_LEN(MAX_LEN(DATA_PACKET_LEN, RREQ_PACKET_LEN), MAX_LEN(RREP_PACKET_LEN, RERR_PACKET_LEN)) + 1) // longest packet (terminator included)
 
 
 
@@ -58,10 +103,14 @@
 void data2packet(struct DATA_PACKET* data, char* packet);
 void rreq2packet(struct RREQ_PACKET* rreq, char* packet);
 void rrep2packet(struct RREP_PACKET* rrep, char* packet);
+void rerr2packet(struct RERR_PACKET* rerr, char* packet);
 
 /*-------------------packet to struct------*/
-char packet2data(char* packet, struct DATA_PACKET* data);
-char packet2rreq(char* packet, struct RREQ_PACKET* rreq);
-char packet2rrep(char* packet, struct RREP_PACKET* rrep);
+// "len" is the number of bytes actually received: malformed or short
+// packets are rejected (return 0)
+char packet2data(const char* packet, int len, struct DATA_PACKET* data);
+char packet2rreq(const char* packet, int len, struct RREQ_PACKET* rreq);
+char packet2rrep(const char* packet, int len, struct RREP_PACKET* rrep);
+char packet2rerr(const char* packet, int len, struct RERR_PACKET* rerr);
 
 #endif //STRUCT2PACKET
@@ -0,0 +1,62 @@
+/*
+ * Parse throughput of the struct2packet.c parsers (packets/s on the host).
+ * Only meant to compare versions of the parsers with each other.
+ */
+
+#include "struct2packet.h"
+#include <time.h>
+
+#define ROUNDS 2000000L
+
+static volatile int sink;   // keeps the parsed results alive
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char* name, double seconds)
+{
+    printf("%-12s %10.0f packets/s\n", name, ROUNDS / seconds);
+}
+
+int main()
+{
+    struct DATA_PACKET data = {9, 3, 0x12, 0x07, 65000, 12, 0x00f0, 0xa5f1, 17, "** 42 ****"};
+    struct RREQ_PACKET rreq = {MAX_REQ_ID, 10, 1, 8, 1};
+    struct RREP_PACKET rrep = {1234, 5, 7, 3, 42, 1};
+    struct RERR_PACKET rerr = {6};
+    char dataPkt[DATA_PACKET_LEN+1], rreqPkt[RREQ_PACKET_LEN+1];
+    char rrepPkt[RREP_PACKET_LEN+1], rerrPkt[RERR_PACKET_LEN+1];
+    double start;
+    long i;
+
+    data2packet(&data, dataPkt);
+    rreq2packet(&rreq, rreqPkt);
+    rrep2packet(&rrep, rrepPkt);
+    rerr2packet(&rerr, rerrPkt);
+
+    start = now();
+    for(i=0; i<ROUNDS; i++)
+        sink += packet2data(dataPkt, DATA_PACKET_LEN, &data);
+    report("packet2data", now() - start);
+
+    start = now();
+    for(i=0; i<ROUNDS; i++)
+        sink += packet2rreq(rreqPkt, RREQ_PACKET_LEN, &rreq);
+    report("packet2rreq", now() - start);
+
+    start = now();
+    for(i=0; i<ROUNDS; i++)
+        sink += packet2rrep(rrepPkt, RREP_PACKET_LEN, &rrep);
+    report("packet2rrep", now() - start);
+
+    start = now();
+    for(i=0; i<ROUNDS; i++)
+        sink += packet2rerr(rerrPkt, RERR_PACKET_LEN, &rerr);
+    report("packet2rerr", now() - start);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Fuzz harness of the struct2packet.c parsers: every input is handed to
+ * all the packet2* functions, which must never read out of bounds.
+ *
+ * libFuzzer: make fuzz && ./fuzz_struct2packet corpus/
+ * Without clang, "make fuzz-check" links the harness with the small driver
+ * below (FUZZ_STANDALONE) and runs it, under ASan and UBSan, on the given
+ * files or on random mutations of valid packets.
+ */
+
+#include "struct2packet.h"
+#include <stdint.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t* input, size_t size)
+{
+    struct DATA_PACKET data;
+    struct RREQ_PACKET rreq;
+    struct RREP_PACKET rrep;
+    struct RERR_PACKET rerr;
+    char* packet;
+
+    // exact size copy, not terminated: reads past "size" are caught by ASan
+    packet = malloc(size ? size : 1);
+    if(packet == NULL)
+        return 0;
+    memcpy(packet, input, size);
+
+    if(packet2data(packet, (int)size, &data))
+    {
+        // the payload is always terminated inside its buffer
+        if(strlen(data.payload) >= DATA_PAYLOAD_LEN)
+            abort();
+    }
+    packet2rreq(packet, (int)size, &rreq);
+    packet2rrep(packet, (int)size, &rrep);
+    packet2rerr(packet, (int)size, &rerr);
+
+    free(packet);
+    return 0;
+}
+
+
+#ifdef FUZZ_STANDALONE
+
+#define MUTATIONS 200000
+#define PACKET_BUF 128      // holds any packet (802.15.4 frame)
+
+static void runFile(const char* name)
+{
+    static uint8_t buf[4096];
+    size_t size;
+    FILE* f = fopen(name, "rb");
+
+    if(f == NULL)
+    {
+        printf("cannot open %s\n", name);
+        exit(1);
+    }
+    size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(buf, size);
+}
+
+// flips, replaces and truncates the bytes of valid packets
+static void runMutations()
+{
+    static const char alphabet[] = "0123456789abcdefABCDEF :;-+x\0";
+    char seeds[4][PACKET_BUF];
+    uint8_t buf[PACKET_BUF];
+    struct DATA_PACKET data = {9, 3, 0x12, 0x07, 65000, 12, 0x00f0, 0xa5f1, 17, "** 42 ****"};
+    struct RREQ_PACKET rreq = {MAX_REQ_ID, 10, 1, 8, 1};
+    struct RREP_PACKET rrep = {1234, 5, 7, 3, 42, 1};
+    struct RERR_PACKET rerr = {6};
+    size_t size;
+    long i;
+    int j, n;
+
+    data2packet(&data, seeds[0]);
+    rreq2packet(&rreq, seeds[1]);
+    rrep2packet(&rrep, seeds[2]);
+    rerr2packet(&rerr, seeds[3]);
+    srand(1);
+    for(i=0; i<MUTATIONS; i++)
+    {
+        j = rand() % 4;
+        size = strlen(seeds[j]) + (j == 0);
+        memcpy(buf, seeds[j], size);
+        for(n = 1 + rand() % 4; n > 0; n--)
+            buf[rand() % size] = alphabet[rand() % (sizeof(alphabet)-1)];
+        if(rand() % 4 == 0)
+            size = rand() % (size + 1);
+        LLVMFuzzerTestOneInput(buf, size);
+    }
+    printf("%d mutations parsed\n", MUTATIONS);
+}
+
+int main(int argc, char** argv)
+{
+    int i;
+
+    if(argc < 2)
+        runMutations();
+    for(i=1; i<argc; i++)
+        runFile(argv[i]);
+    return 0;
+}
+
+#endif
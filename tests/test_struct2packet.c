@@ -0,0 +1,298 @@
+/*
+ * Host unit tests of struct2packet.c: every packet survives a round trip
+ * and malformed or short packets are rejected
+ */
+
+#include "struct2packet.h"
+
+#define PACKET_BUF 128      // holds any packet (802.15.4 frame)
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while(0)
+
+
+/*---------------------helpers---------------------------------*/
+
+// replaces the first occurrence of "from" in packet with "to" (same length)
+static void patch(char* packet, const char* from, const char* to)
+{
+    char* at = strstr(packet, from);
+    CHECK(at != NULL && strlen(from) == strlen(to));
+    if(at != NULL)
+        memcpy(at, to, strlen(to));
+}
+
+static void sampleData(struct DATA_PACKET* data)
+{
+    memset(data, 0, sizeof(*data));
+    data->dest = 9;
+    data->src = 3;
+    data->epoch = 0x12;
+    data->ack_epoch = 0x07;
+    data->seq = 65000;
+    data->ack = 12;
+    data->sack = 0x00f0;
+    data->mask = 0xa5f1;
+    data->load = 17;
+    strcpy(data->payload, "** 42 ****");
+}
+
+
+/*---------------------round trips-----------------------------*/
+
+static void testDataRoundTrip()
+{
+    struct DATA_PACKET in, out;
+    char packet[DATA_PACKET_LEN+1];
+
+    sampleData(&in);
+    data2packet(&in, packet);
+    CHECK(strlen(packet) == DATA_PACKET_LEN - 1);
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &out) == 1);
+    CHECK(out.dest == in.dest && out.src == in.src && out.load == in.load);
+#if RELIABLE_DATA
+    CHECK(out.epoch == in.epoch && out.ack_epoch == in.ack_epoch);
+    CHECK(out.seq == in.seq && out.ack == in.ack && out.sack == in.sack);
+#else
+    // not on the air: read as unreliable DATA
+    CHECK(out.epoch == 0 && out.ack_epoch == 0);
+    CHECK(out.seq == 0 && out.ack == 0 && out.sack == 0);
+#endif
+#if GROUP_TRAFFIC
+    CHECK(out.mask == in.mask);
+#else
+    CHECK(out.mask == 0);
+#endif
+    CHECK(strcmp(out.payload, in.payload) == 0);
+
+    // payload shorter than the frame, and empty (pure ack)
+    in.payload[0] = '\0';
+    data2packet(&in, packet);
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &out) == 1);
+    CHECK(out.payload[0] == '\0');
+
+#if RELIABLE_DATA
+    // widest epochs
+    in.epoch = MAX_EPOCH;
+    in.ack_epoch = MAX_EPOCH;
+    data2packet(&in, packet);
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &out) == 1);
+    CHECK(out.epoch == MAX_EPOCH && out.ack_epoch == MAX_EPOCH);
+#endif
+}
+
+static void testRreqRoundTrip()
+{
+    struct RREQ_PACKET in = {MAX_REQ_ID, 10, 1, 8, 0xa7}, out;
+    char packet[RREQ_PACKET_LEN+1];
+
+    rreq2packet(&in, packet);
+    CHECK(strlen(packet) == RREQ_PACKET_LEN);
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &out) == 1);
+    CHECK(out.req_id == in.req_id && out.dest == in.dest);
+    CHECK(out.src == in.src && out.ttl == in.ttl && out.epoch == in.epoch);
+}
+
+static void testRrepRoundTrip()
+{
+    struct RREP_PACKET in = {1234, 5, 7, 3, 42, MAX_EPOCH}, out;
+    char packet[RREP_PACKET_LEN+1];
+
+    rrep2packet(&in, packet);
+    CHECK(strlen(packet) == RREP_PACKET_LEN);
+    CHECK(packet2rrep(packet, RREP_PACKET_LEN, &out) == 1);
+    CHECK(out.req_id == in.req_id && out.dest == in.dest && out.src == in.src);
+    CHECK(out.hops == in.hops && out.load == in.load && out.epoch == in.epoch);
+}
+
+static void testRerrRoundTrip()
+{
+    struct RERR_PACKET in = {6}, out;
+    char packet[RERR_PACKET_LEN+1];
+
+    rerr2packet(&in, packet);
+    CHECK(strlen(packet) == RERR_PACKET_LEN);
+    CHECK(packet2rerr(packet, RERR_PACKET_LEN, &out) == 1);
+    CHECK(out.dest == in.dest);
+}
+
+
+/*---------------------rejections------------------------------*/
+
+static void testTruncated()
+{
+    struct DATA_PACKET data;
+    struct RREQ_PACKET rreq = {1, 2, 3, 4, 1};
+    struct RREP_PACKET rrep = {1, 2, 3, 4, 5, 1};
+    struct RERR_PACKET rerr = {2};
+    char packet[PACKET_BUF];
+
+    sampleData(&data);
+    data2packet(&data, packet);
+    CHECK(packet2data(packet, DATA_HEADER_LEN - 1, &data) == 0);
+    CHECK(packet2data(packet, 0, &data) == 0);
+    rreq2packet(&rreq, packet);
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN - 1, &rreq) == 0);
+    rrep2packet(&rrep, packet);
+    CHECK(packet2rrep(packet, RREP_PACKET_LEN - 1, &rrep) == 0);
+    rerr2packet(&rerr, packet);
+    CHECK(packet2rerr(packet, RERR_PACKET_LEN - 1, &rerr) == 0);
+}
+
+static void testNonDigit()
+{
+    struct DATA_PACKET data;
+    struct RREQ_PACKET rreq = {12, 2, 3, 4, 1};
+    struct RREP_PACKET rrep = {1, 2, 3, 4, 5, 1};
+    char packet[PACKET_BUF];
+
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "DEST: 9", "DEST:x9");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "LOAD:17", "LOAD:1 ");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+
+    rreq2packet(&rreq, packet);
+    patch(packet, "   12", "  -12");
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &rreq) == 0);
+
+    rrep2packet(&rrep, packet);
+    patch(packet, "HOPS: 4", "HOPS:+4");
+    CHECK(packet2rrep(packet, RREP_PACKET_LEN, &rrep) == 0);
+}
+
+static void testWrongLabels()
+{
+    struct DATA_PACKET data;
+    struct RREQ_PACKET rreq = {12, 2, 3, 4, 1};
+    struct RREP_PACKET rrep = {1, 2, 3, 4, 5, 1};
+    struct RERR_PACKET rerr = {2};
+    char packet[PACKET_BUF];
+
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "SRC", "SRX");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+
+#if GROUP_TRAFFIC
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, ";MASK", ",MASK");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+#endif
+
+#if RELIABLE_DATA
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "EPOCH", "EPOCK");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+#endif
+
+    rreq2packet(&rreq, packet);
+    patch(packet, "TTL", "TLL");
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &rreq) == 0);
+
+    // a reply is not a request and vice versa
+    rrep2packet(&rrep, packet);
+    CHECK(packet2rreq(packet, RREP_PACKET_LEN, &rreq) == 0);
+    CHECK(packet2data(packet, RREP_PACKET_LEN, &data) == 0);
+
+    rerr2packet(&rerr, packet);
+    patch(packet, "DEST", "dest");
+    CHECK(packet2rerr(packet, RERR_PACKET_LEN, &rerr) == 0);
+}
+
+static void testUppercaseHex()
+{
+    struct DATA_PACKET data;
+    struct RREQ_PACKET rreq = {12, 2, 3, 4, 0xab};
+    char packet[PACKET_BUF];
+
+    rreq2packet(&rreq, packet);
+    patch(packet, "EPOCH:ab", "EPOCH:Ab");
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &rreq) == 0);
+
+#if RELIABLE_DATA
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "SACK:00f0", "SACK:00F0");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+
+    // both epochs are checked, not only the first one
+    sampleData(&data);
+    data.ack_epoch = 0xab;
+    data2packet(&data, packet);
+    patch(packet, "EPOCH:12ab", "EPOCH:12aB");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+    patch(packet, "EPOCH:12aB", "EPOCH:12a;");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+#endif
+
+#if GROUP_TRAFFIC
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "MASK:a5f1", "MASK:A5f1");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+#endif
+    (void)data;
+}
+
+static void testIdOutOfRange()
+{
+    struct DATA_PACKET data;
+    struct RREQ_PACKET rreq = {12, 2, 3, 4, 1};
+    struct RREP_PACKET rrep = {12, 2, 3, 4, 5, 1};
+    char packet[PACKET_BUF];
+
+    rreq2packet(&rreq, packet);
+    patch(packet, "REQ_ID:   12", "REQ_ID:65536");
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &rreq) == 0);
+    patch(packet, "REQ_ID:65536", "REQ_ID:99999");
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &rreq) == 0);
+    patch(packet, "REQ_ID:99999", "REQ_ID:65535");
+    CHECK(packet2rreq(packet, RREQ_PACKET_LEN, &rreq) == 1);
+
+    rrep2packet(&rrep, packet);
+    patch(packet, "REQ_ID:   12", "REQ_ID:70000");
+    CHECK(packet2rrep(packet, RREP_PACKET_LEN, &rrep) == 0);
+
+#if RELIABLE_DATA
+    sampleData(&data);
+    data2packet(&data, packet);
+    patch(packet, "SEQ:65000", "SEQ:65536");
+    CHECK(packet2data(packet, DATA_PACKET_LEN, &data) == 0);
+#endif
+    (void)data;
+}
+
+
+int main()
+{
+    testDataRoundTrip();
+    testRreqRoundTrip();
+    testRrepRoundTrip();
+    testRerrRoundTrip();
+    testTruncated();
+    testNonDigit();
+    testWrongLabels();
+    testUppercaseHex();
+    testIdOutOfRange();
+
+    if(failures != 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("struct2packet: all tests passed\n");
+    return 0;
+}
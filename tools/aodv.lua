@@ -0,0 +1,147 @@
+-- Wireshark dissector for the AODV frames of this project, as captured by
+-- tools/trace2pcap.py (link type USER0).
+--
+-- Every record is a 4 byte trace header (direction, node, peer, rime channel)
+-- followed by the text frame built by struct2packet.c:
+--     HEADER;LABEL:value;LABEL:value;...
+--
+-- Load it with: wireshark -X lua_script:tools/aodv.lua capture.pcap
+-- or copy it to the Wireshark personal plugins folder.
+
+local trace = Proto("aodvtrace", "AODV Mote Trace")
+local aodv = Proto("aodv", "AODV (text frames)")
+
+-- rime channels, as defined in main.c
+local channels = {
+    [22] = "ROUTE_REPLY",
+    [23] = "DATA",
+    [24] = "ROUTE_ERROR",
+    [25] = "SINK_BEACON",
+    [26] = "ROUTE_REQUEST",
+}
+
+local tf = {
+    direction = ProtoField.uint8("aodvtrace.direction", "Direction", base.DEC, {[0] = "Sent", [1] = "Received"}),
+    node = ProtoField.uint8("aodvtrace.node", "Node", base.DEC),
+    peer = ProtoField.uint8("aodvtrace.peer", "Peer", base.DEC, {[0] = "Broadcast"}),
+    channel = ProtoField.uint8("aodvtrace.channel", "Rime channel", base.DEC, channels),
+}
+trace.fields = {tf.direction, tf.node, tf.peer, tf.channel}
+
+-- one field per label of struct2packet.h
+local af = {
+    type = ProtoField.string("aodv.type", "Type"),
+    REQ_ID = ProtoField.uint16("aodv.req_id", "Request ID", base.DEC),
+    DEST = ProtoField.uint8("aodv.dest", "Destination", base.DEC),
+    SRC = ProtoField.uint8("aodv.src", "Source", base.DEC),
+    EPOCH = ProtoField.uint16("aodv.epoch", "Boot epoch (DATA: of seq, of ack)", base.HEX),
+    HOPS = ProtoField.uint8("aodv.hops", "Hops", base.DEC),
+    TTL = ProtoField.uint8("aodv.ttl", "TTL", base.DEC),
+    LOAD = ProtoField.uint8("aodv.load", "Load", base.DEC),
+    SEQ = ProtoField.uint16("aodv.seq", "Sequence number", base.DEC),
+    ACK = ProtoField.uint16("aodv.ack", "Acknowledged up to", base.DEC),
+    SACK = ProtoField.uint16("aodv.sack", "Selective ack", base.HEX),
+    MASK = ProtoField.uint16("aodv.mask", "Group members", base.HEX),
+    PAYLOAD = ProtoField.string("aodv.payload", "Payload"),
+}
+aodv.fields = {af.type, af.REQ_ID, af.DEST, af.SRC, af.HOPS, af.TTL, af.LOAD,
+               af.EPOCH, af.SEQ, af.ACK, af.SACK, af.MASK, af.PAYLOAD}
+
+local hex_labels = {EPOCH = true, SACK = true, MASK = true}
+
+function aodv.dissector(tvb, pinfo, tree)
+    local text = tvb:string()
+    local subtree = tree:add(aodv, tvb())
+    local values = {}
+    local offset = 0
+
+    -- items are separated by ';', the payload may contain anything but '\0'
+    while offset < #text do
+        local stop = text:find(";", offset + 1, true)
+        local item = text:sub(offset + 1, (stop or #text + 1) - 1)
+        local range = tvb(offset, #item > 0 and #item or 1)
+
+        if offset == 0 then
+            values.type = item
+            subtree:add(af.type, range, item)
+        else
+            local label, value = item:match("^([%u_]+):(.*)$")
+            if label == "PAYLOAD" then
+                -- payload is last and may hold ';'
+                value = text:sub(offset + #label + 2)
+                subtree:add(af.PAYLOAD, tvb(offset, #text - offset), value)
+                values.PAYLOAD = value
+                break
+            elseif label ~= nil and af[label] ~= nil then
+                local number = tonumber(value:match("^%s*(.-)%s*$"), hex_labels[label] and 16 or 10)
+                if number ~= nil then
+                    subtree:add(af[label], range, number)
+                    values[label] = number
+                end
+            elseif #item > 0 then
+                subtree:add_expert_info(PI_MALFORMED, PI_WARN, "Unknown item: " .. item)
+            end
+        end
+        if stop == nil then
+            break
+        end
+        offset = stop
+    end
+    return values
+end
+
+function trace.dissector(tvb, pinfo, tree)
+    if tvb:len() < 4 then
+        return 0
+    end
+    local direction = tvb(0, 1):uint()
+    local node = tvb(1, 1):uint()
+    local peer = tvb(2, 1):uint()
+    local channel = tvb(3, 1):uint()
+
+    local subtree = tree:add(trace, tvb(0, 4))
+    subtree:add(tf.direction, tvb(0, 1))
+    subtree:add(tf.node, tvb(1, 1))
+    subtree:add(tf.peer, tvb(2, 1))
+    subtree:add(tf.channel, tvb(3, 1))
+
+    -- link level addresses: sender and receiver of the frame
+    local peer_name = peer == 0 and "broadcast" or tostring(peer)
+    if direction == 0 then
+        pinfo.cols.src = tostring(node)
+        pinfo.cols.dst = peer_name
+    else
+        pinfo.cols.src = tostring(peer)
+        pinfo.cols.dst = tostring(node)
+    end
+    pinfo.cols.protocol = "AODV"
+
+    local v = aodv.dissector(tvb(4):tvb(), pinfo, tree)
+    local kind = channels[channel] or v.type or "?"
+    local info = string.format("%s @%d %s", direction == 0 and "TX" or "RX", node, kind)
+    if v.type == "ROUTE_REQUEST" then
+        info = info .. string.format(" id=%d %d->%d ttl=%d", v.REQ_ID or 0, v.SRC or 0, v.DEST or 0, v.TTL or 0)
+    elseif v.type == "ROUTE_REPLY" then
+        info = info .. string.format(" id=%d %d->%d hops=%d load=%d", v.REQ_ID or 0, v.SRC or 0, v.DEST or 0,
+                                     v.HOPS or 0, v.LOAD or 0)
+    elseif v.type == "ROUTE_ERROR" then
+        info = info .. string.format(" dest=%d", v.DEST or 0)
+    elseif v.type == "DATA" then
+        info = info .. string.format(" %d->%d", v.SRC or 0, v.DEST or 0)
+        if (v.SEQ or 0) ~= 0 then
+            info = info .. string.format(" seq=%d/%d", math.floor((v.EPOCH or 0) / 256), v.SEQ)
+        end
+        if (v.ACK or 0) ~= 0 then
+            info = info .. string.format(" ack=%d/%d sack=0x%04x", (v.EPOCH or 0) % 256, v.ACK, v.SACK or 0)
+        end
+        if (v.MASK or 0) ~= 0 then
+            info = info .. string.format(" mask=0x%04x", v.MASK)
+        end
+        info = info .. " {" .. (v.PAYLOAD or "") .. "}"
+    end
+    pinfo.cols.info = info
+    return tvb:len()
+end
+
+local encaps = wtap_encaps or wtap
+DissectorTable.get("wtap_encap"):add(encaps.USER0, trace)
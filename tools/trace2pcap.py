@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+#
+# Converts the TRACE lines of a Cooja log (main.c built with PACKET_TRACE 1)
+# into a pcap file, one record per frame sent or received by a mote.
+#
+# Input: the file saved by the Cooja Log Listener ("Save to file"), one line
+# per message in the form
+#     <time> ID:<node> TRACE <T|R> <peer> <rime channel> <frame>
+# where <time> is in milliseconds (or mm:ss.mmm when the Log Listener shows
+# formatted time).
+#
+# Output: pcap with link type USER0 (147). Every record is a 4 byte trace
+# header followed by the AODV frame exactly as it went on air:
+#     direction (0 sent, 1 received), node, peer (0 broadcast), rime channel
+# Open it with Wireshark after loading tools/aodv.lua.
+#
+# usage: trace2pcap.py [--usec] loglistener.txt capture.pcap
+
+import re
+import struct
+import sys
+
+LINKTYPE_USER0 = 147
+LINE = re.compile(r'^\s*(\S+)\s+ID:(\d+)\s+TRACE ([TR]) (\d+) (\d+) (.*?)\r?$')
+
+
+def parse_time(text, usec):
+    """Returns the timestamp of a log line in microseconds"""
+    if ':' not in text:
+        return int(text) if usec else int(text) * 1000
+    # [hh:]mm:ss.mmm
+    seconds = 0.0
+    for part in text.split(':'):
+        seconds = seconds * 60 + float(part)
+    return int(round(seconds * 1000000))
+
+
+def convert(src, dst, usec):
+    frames = 0
+    dst.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, LINKTYPE_USER0))
+    for line in src:
+        match = LINE.match(line)
+        if match is None:
+            continue
+        time, node, direction, peer, channel, frame = match.groups()
+        stamp = parse_time(time, usec)
+        record = struct.pack('BBBB', 0 if direction == 'T' else 1,
+                             int(node), int(peer), int(channel))
+        record += frame.encode('ascii', 'replace')
+        dst.write(struct.pack('<IIII', stamp // 1000000, stamp % 1000000,
+                              len(record), len(record)))
+        dst.write(record)
+        frames += 1
+    return frames
+
+
+def main(argv):
+    usec = '--usec' in argv
+    args = [a for a in argv[1:] if a != '--usec']
+    if len(args) != 2:
+        sys.stderr.write('usage: %s [--usec] loglistener.txt capture.pcap\n' % argv[0])
+        return 1
+    with open(args[0], 'r', errors='replace') as src, open(args[1], 'wb') as dst:
+        frames = convert(src, dst, usec)
+    print('%d frames written to %s' % (frames, args[1]))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))